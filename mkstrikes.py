@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+# make strikes.ttf, a tiny font with only a 12 ppem bitmap strike, to test
+# the EBLC/EBDT reader in zhitest.cc. glyf 1+5*i+j uses index format
+# (1, 2, 3)[i] and image format (1, 2, 5, 6, 7)[j]. every one of them is
+# the same 5 wide, 7 tall X. glyf 16 is listed with no image.
+# index format 1 or 3 with image format 5 is not valid (format 5 images
+# have no metrics of their own), and zhitest.cc must refuse those.
+
+import struct
+
+ROWS = [0b10001, 0b01010, 0b00100, 0b00100, 0b00100, 0b01010, 0b10001]
+WIDTH, HEIGHT = 5, 7
+PPEM = 12
+INDEX_FORMATS = (1, 2, 3)
+IMAGE_FORMATS = (1, 2, 5, 6, 7)
+
+def byte_aligned():
+    return bytes(r << (8 - WIDTH) for r in ROWS)
+
+def bit_aligned():
+    bits = ''.join(format(r, '0%db' % WIDTH) for r in ROWS)
+    bits += '0' * (-len(bits) % 8)
+    return bytes(int(bits[i:i+8], 2) for i in range(0, len(bits), 8))
+
+# height width bearingX bearingY advance (+ vertical for big metrics)
+small_metrics = struct.pack('>BBbbB', HEIGHT, WIDTH, 0, HEIGHT, WIDTH + 1)
+big_metrics = struct.pack('>BBbbBbbB', HEIGHT, WIDTH, 0, HEIGHT, WIDTH + 1, 0, 0, 0)
+
+def image(fmt):
+    return {
+        1: small_metrics + byte_aligned(),
+        2: small_metrics + bit_aligned(),
+        5: bit_aligned(),
+        6: big_metrics + byte_aligned(),
+        7: big_metrics + bit_aligned(),
+    }[fmt]
+
+ebdt = b'\0\2\0\0'
+subtables = []  # (glyf, index subtable)
+glyf = 1
+for index_format in INDEX_FORMATS:
+    for image_format in IMAGE_FORMATS:
+        data = image(image_format)
+        offset = len(ebdt)
+        ebdt += data
+        head = struct.pack('>HHI', index_format, image_format, offset)
+        if index_format == 1:
+            sub = head + struct.pack('>II', 0, len(data))
+        elif index_format == 2:
+            sub = head + struct.pack('>I', len(data)) + big_metrics
+        else:
+            sub = head + struct.pack('>HH', 0, len(data))
+        subtables.append((glyf, sub))
+        glyf += 1
+subtables.append((glyf, struct.pack('>HHIII', 1, 1, len(ebdt), 0, 0)))
+
+array_offset = 8 + 48
+array = b''
+body = b''
+for g, sub in subtables:
+    array += struct.pack('>HHI', g, g, 8 * len(subtables) + len(body))
+    body += sub
+bitmap_size = struct.pack('>IIII', array_offset, len(array + body), len(subtables), 0)
+bitmap_size += b'\0' * 24  # hori and vert sbitLineMetrics
+bitmap_size += struct.pack('>HHBBBb', 1, glyf, PPEM, PPEM, 1, 1)
+eblc = b'\0\2\0\0' + struct.pack('>I', 1) + bitmap_size + array + body
+
+head = struct.pack('>IIIIHHQQhhhhHHhhh', 0x10000, 0x10000, 0, 0x5F0F3CF5,
+                   0, 1000, 0, 0, 0, 0, 1000, 1000, 0, 8, 2, 0, 0)
+hhea = struct.pack('>Ihhh', 0x10000, 800, -200, 0) + b'\0' * 24 + struct.pack('>H', 0)
+
+tables = [(b'EBDT', ebdt), (b'EBLC', eblc), (b'head', head), (b'hhea', hhea)]
+out = struct.pack('>IHHHH', 0x10000, len(tables), 64, 2, 0)
+offset = 12 + 16 * len(tables)
+data = b''
+for tag, t in tables:
+    out += tag + struct.pack('>III', 0, offset + len(data), len(t))
+    data += t + b'\0' * (-len(t) % 4)
+open('strikes.ttf', 'wb').write(out + data)
@@ -81,6 +81,10 @@ A3. There will be no error reporting due to code size requirements being
 
 Simple glyphs only, no Compound Glyphs are supported.
 
+Only the format 4 cmap is read so far, so only the Basic Multilingual
+Plane (code points up to 0xFFFF) can be found. Emoji and the other code
+points above that never resolve, in any font of a fontset.
+
 
 See also
 Basic overview and format details:
@@ -272,7 +276,10 @@ Dr Norman Wilderger's youtube channel
 #include <stdint.h>
 #include <stdio.h>
 
+// build with -DNODEBUG to drop the trace printf()s and dump routines
+#ifndef NODEBUG
 #define DEBUG 1
+#endif
 
 // Number types, byte order, endian-ness:
 // https://developer.apple.com/fonts/TrueType-Reference-Manual/RM06/Chap6.html#Types
@@ -345,7 +352,18 @@ typedef struct fontinfo_t {
 	union uint32 glyf_table_offset;
 	union uint32 loca_table_offset;
 	union uint32 head_table_offset;
+	union uint32 eblc_table_offset; // or CBLC, same layout
+	union uint32 ebdt_table_offset; // or CBDT
 	union int16  head_table_indexToLocFormat;
+	union uint16 head_table_unitsPerEm;
+	union uint32 hhea_table_offset;
+	union int16  hhea_table_ascent;
+	union int16  hhea_table_descent; // negative, below baseline
+	union int16  hhea_table_lineGap;
+	union uint16 hhea_table_numberOfHMetrics;
+	union uint32 hmtx_table_offset;
+	union uint32 maxp_table_offset;
+	union uint16 maxp_table_numGlyphs;
 } fontinfo;
 
 // Part of main Font Directory, at beginning of file
@@ -376,6 +394,21 @@ void read_table_directories( fontinfo &fi, FILE * file ) {
 			fi.loca_table_offset = td.offset;
 		} else if (equal(td.tag,"head")) {
 			fi.head_table_offset = td.offset;
+		} else if (equal(td.tag,"hhea")) {
+			fi.hhea_table_offset = td.offset;
+		} else if (equal(td.tag,"hmtx")) {
+			fi.hmtx_table_offset = td.offset;
+		} else if (equal(td.tag,"maxp")) {
+			fi.maxp_table_offset = td.offset;
+		} else if (equal(td.tag,"EBLC")) {
+			fi.eblc_table_offset = td.offset;
+		} else if (equal(td.tag,"EBDT")) {
+			fi.ebdt_table_offset = td.offset;
+		} else if (equal(td.tag,"CBLC")) {
+			// tags are sorted, so EBLC (if any) comes later and wins
+			fi.eblc_table_offset = td.offset;
+		} else if (equal(td.tag,"CBDT")) {
+			fi.ebdt_table_offset = td.offset;
 		}
 	}
 }
@@ -395,7 +428,7 @@ void read_head_table( fontinfo &fi, FILE * f ) {
 	//printf("magic %08x\n",tmp.uint32); // sould be 0x5F0F3CF5
 	fseek( f, 4, SEEK_CUR ); //magic number
 	fseek( f, 2, SEEK_CUR ); //flags
-	fseek( f, 2, SEEK_CUR ); //unitsPerEm
+	read_uint16( fi.head_table_unitsPerEm, f );
 	fseek( f, 8, SEEK_CUR ); //time created
 	fseek( f, 8, SEEK_CUR ); //time modified
 	fseek( f, 2, SEEK_CUR ); //xmin
@@ -409,10 +442,54 @@ void read_head_table( fontinfo &fi, FILE * f ) {
 	fseek( f, 2, SEEK_CUR ); //glyphDataFormat
 }
 
+// horizontal header. line spacing, and the number of entries in hmtx.
+void read_hhea_table( fontinfo &fi, FILE * f ) {
+	fseek( f, fi.hhea_table_offset.uint32, SEEK_SET );
+	fseek( f, 4, SEEK_CUR ); // version
+	read_int16( fi.hhea_table_ascent, f );
+	read_int16( fi.hhea_table_descent, f );
+	read_int16( fi.hhea_table_lineGap, f );
+	fseek( f, 24, SEEK_CUR ); // advanceWidthMax ... metricDataFormat
+	read_uint16( fi.hhea_table_numberOfHMetrics, f );
+}
+
+// maximum profile. only the glyph count is kept.
+void read_maxp_table( fontinfo &fi, FILE * f ) {
+	fi.maxp_table_numGlyphs.uint16 = 0;
+	if (fi.maxp_table_offset.uint32==0) return;
+	fseek( f, fi.maxp_table_offset.uint32, SEEK_SET );
+	fseek( f, 4, SEEK_CUR ); // version
+	read_uint16( fi.maxp_table_numGlyphs, f );
+}
+
+// read the offset subtable, table directory, and head table of a font
+// that has just been opened. tables that are not found keep offset 0.
+void read_fontinfo( fontinfo &fi, FILE * f ) {
+	fi.cmap_table_offset.uint32 = 0;
+	fi.glyf_table_offset.uint32 = 0;
+	fi.loca_table_offset.uint32 = 0;
+	fi.head_table_offset.uint32 = 0;
+	fi.hhea_table_offset.uint32 = 0;
+	fi.hmtx_table_offset.uint32 = 0;
+	fi.maxp_table_offset.uint32 = 0;
+	fi.eblc_table_offset.uint32 = 0;
+	fi.ebdt_table_offset.uint32 = 0;
+	fseek( f, 0, SEEK_SET );
+	read_uint32( fi.ofascaler, f );
+	read_uint16( fi.numtables, f );
+	fseek( f, 12, SEEK_SET ); // skip Offset Subtable
+	read_table_directories( fi, f );
+	read_head_table( fi, f );
+	read_hhea_table( fi, f );
+	read_maxp_table( fi, f );
+}
+
 // given 16 bit unicode, look up glyg index in a CMAP Format 4 table
 // 32 bit unicode is not compatible with format 4 tables.
 void lookup_cmap_format4( FILE * f, union uint32 &glyf_index, uint16_t &unicode16 ) {
+#ifdef DEBUG
 	printf(" searching fmt4 table for unicode %u x%04x\n",unicode16,unicode16 );
+#endif
 	cmap_subtable_format4 fm;
 	read_uint16( fm.length, f );
 	read_uint16( fm.language, f );
@@ -420,12 +497,14 @@ void lookup_cmap_format4( FILE * f, union uint32 &glyf_index, uint16_t &unicode1
 	read_uint16( fm.searchRange, f );
 	read_uint16( fm.entrySelector, f );
 	read_uint16( fm.rangeShift, f );
+#ifdef DEBUG
 	printf( "length %u\n", fm.length.uint16 );
 	printf( "language %u\n", fm.language.uint16 );
 	printf( "segCountX2 %u\n", fm.segCountX2.uint16 );
 	printf( "searchRange %u\n", fm.searchRange.uint16 );
 	printf( "entrySelector %u\n", fm.entrySelector.uint16 );
 	printf( "rangeShift %u\n", fm.rangeShift.uint16 );
+#endif
 	fm.endCodeArray = ftell( f );
 	fm.startCodeArray = fm.endCodeArray + fm.segCountX2.uint16 + 2;
 	// skip uint16 reservedPad
@@ -445,24 +524,38 @@ void lookup_cmap_format4( FILE * f, union uint32 &glyf_index, uint16_t &unicode1
 		if (counter>segCount) break;
 		fseek( f, endcode_i, SEEK_SET );
 		read_uint16( endcode, f );
+#ifdef DEBUG
 		printf("end code x%04x\n",endcode.uint16);
+#endif
 		if (endcode.uint16 >= unicode16) {
+#ifdef DEBUG
 			printf(" >= unicode \n");
+#endif
 			fseek( f, startcode_i, SEEK_SET );
 			read_uint16( startcode, f );
+#ifdef DEBUG
 			printf("start code x%04x\n",startcode.uint16);
+#endif
 			if (startcode.uint16 <= unicode16) {
+#ifdef DEBUG
 				printf(" <= unicode \n");
+#endif
 				fseek( f, iddelta_i, SEEK_SET );
 				read_uint16( iddelta, f );
 				fseek( f, idrangeoffset_i, SEEK_SET );
 				read_uint16( idrangeoffset, f );
+#ifdef DEBUG
 				printf("end %x strt %x delt %u %x rof %x\n", endcode.uint16, startcode.uint16, iddelta.uint16, iddelta.uint16, idrangeoffset.uint16 );
+#endif
 				if (idrangeoffset.uint16==0) {
+#ifdef DEBUG
 					printf( "rof 0, add delta to unicode\n");
+#endif
 					glyf_index.uint32 = ( iddelta.uint16 + unicode16 ) % 0x10000;
 				} else {
+#ifdef DEBUG
 					printf( "rof !0\n");
+#endif
 					union uint16 tmp;
 					tmp.uint16 = idrangeoffset.uint16 + 2*(unicode16-startcode.uint16);
 					fseek(f, idrangeoffset_i + tmp.uint16, SEEK_SET);
@@ -472,7 +565,9 @@ void lookup_cmap_format4( FILE * f, union uint32 &glyf_index, uint16_t &unicode1
 			}
 			break;
 		} else {
+#ifdef DEBUG
 			printf(" keep looking..\n");
+#endif
 		}
 		endcode_i+=2;
 		startcode_i+=2;
@@ -481,13 +576,10 @@ void lookup_cmap_format4( FILE * f, union uint32 &glyf_index, uint16_t &unicode1
 	}
 }
 
-// given a Unicode look up the glyf index
-void lookup_glyf_index( fontinfo &fi, uint32_t &unicode32, union uint32 &glyf_index, FILE * f ) {
-
-	// init glyf_index using MISSING CHARACTER standard index of 0.
-	// if we can't find anything, it will be 0 on return.
-
-	glyf_index.uint32 = 0;
+// find the first unicode cmap subtable and read its format number.
+// the file is left positioned just after the format field.
+// returns false if there is no unicode subtable we can use.
+bool seek_cmap_subtable( fontinfo &fi, union uint16 &format, FILE * f ) {
 	fseek( f, fi.cmap_table_offset.uint32, SEEK_SET );
 	fseek( f, 2, SEEK_CUR ); //skip version
 	union uint16 numberSubtables;
@@ -495,14 +587,15 @@ void lookup_glyf_index( fontinfo &fi, uint32_t &unicode32, union uint32 &glyf_in
 	read_uint16( numberSubtables, f );
 	uint32_t subtable_i = ftell(f);
 	union uint16 platformID, platformSpecificID;
-	union uint16 format;
 	for (uint16_t i=0;i<numberSubtables.uint16;i++ ) {
 		fseek( f, subtable_i, SEEK_SET );
 		read_uint16( platformID, f );
 		read_uint16( platformSpecificID, f );
 		read_uint32( offset, f );
 		subtable_i = ftell(f);
+#ifdef DEBUG
 		printf(" platID %i, platSpecID %02i, offset x%08x ",platformID.uint16,platformSpecificID.uint16, offset.uint32);
+#endif
 		bool ok = false;
 		if (platformID.uint16==0) ok = true;
 		else if (platformID.uint16==3 && platformSpecificID.uint16==10) ok = true;
@@ -511,17 +604,228 @@ void lookup_glyf_index( fontinfo &fi, uint32_t &unicode32, union uint32 &glyf_in
 			fseek( f, fi.cmap_table_offset.uint32, SEEK_SET );
 			fseek( f, offset.uint32, SEEK_CUR );
 			read_uint16( format, f );
+#ifdef DEBUG
 			printf("format %u\n",format.uint16);
-			if (format.uint16==4) {
-				if (unicode32>0xFFFF) {
-					printf("unicode too big for format 4 table\n");
-				}
-				uint16_t unicode16 = unicode32;
-				lookup_cmap_format4( f, glyf_index, unicode16 );
-			}
-			break;
+#endif
+			return true;
 		} else {
+#ifdef DEBUG
 			printf("< cant parse this kind of cmap\n");
+#endif
+		}
+	}
+	return false;
+}
+
+// given a Unicode look up the glyf index
+void lookup_glyf_index( fontinfo &fi, uint32_t &unicode32, union uint32 &glyf_index, FILE * f ) {
+
+	// init glyf_index using MISSING CHARACTER standard index of 0.
+	// if we can't find anything, it will be 0 on return.
+
+	glyf_index.uint32 = 0;
+	union uint16 format;
+	if (!seek_cmap_subtable( fi, format, f )) return;
+	if (format.uint16==4) {
+		if (unicode32>0xFFFF) {
+#ifdef DEBUG
+			printf("unicode too big for format 4 table\n");
+#endif
+		}
+		uint16_t unicode16 = unicode32;
+		lookup_cmap_format4( f, glyf_index, unicode16 );
+	}
+}
+
+// Font coverage: which unicode code points a font has a glyph for.
+// Built once when a font is added to a fontset, so picking the font for a
+// character is a few memory reads instead of a cmap walk in every font.
+// It covers the 16 bit code points a format 4 table can hold (so nothing
+// above 0xFFFF, see the top of the file), in 256 code point 'pages'.
+//
+// Every page has a coarse byte, one bit for each run of 32 code points
+// that has any glyph at all. On top of that, each page has a two bit
+// state. Pages entirely inside one cmap segment are full and need nothing
+// more (this keeps big CJK fonts cheap). Partly covered pages get an exact
+// 32 byte bitset from a small pool, handed out in page order (format 4
+// segments are sorted). A page's bitset is the number of partly covered
+// pages below it, found from a count kept for every 8 pages plus at most 7
+// more. If the pool runs out, the page is unknown, and only its coarse
+// bits say whether the font's cmap has to be asked. The default pool holds
+// the low pages (Latin, Greek, Cyrillic) of a big font like FreeSerif,
+// which needs 39 for all of its pages.
+#ifndef COVERAGE_MAX_PAGES
+#define COVERAGE_MAX_PAGES 8
+#endif
+#define COVERAGE_EMPTY   0
+#define COVERAGE_PART    1
+#define COVERAGE_FULL    2
+#define COVERAGE_UNKNOWN 3
+
+typedef struct font_coverage_t {
+	uint8_t coarse[256]; // bit n: code points n*32 to n*32+31 of the page
+	uint8_t page[64]; // a COVERAGE_ value for each page, 4 pages per byte
+	uint8_t rank[32]; // partly covered pages below page 8*i
+	uint8_t numpages;
+	uint8_t bits[COVERAGE_MAX_PAGES][32];
+} font_coverage;
+
+uint8_t page_state( font_coverage &fc, uint8_t page ) {
+	return (fc.page[page>>2] >> ((page&3)*2)) & 3;
+}
+
+void set_page_state( font_coverage &fc, uint8_t page, uint8_t state ) {
+	uint8_t shift = (page&3)*2;
+	fc.page[page>>2] = (fc.page[page>>2] & ~(3<<shift)) | state<<shift;
+}
+
+// index into bits of a partly covered page
+uint8_t page_bits( font_coverage &fc, uint8_t page ) {
+	uint8_t n = fc.rank[page>>3];
+	for (uint8_t i=page&0xF8;i<page;i++) {
+		if (page_state( fc, i )==COVERAGE_PART) n++;
+	}
+	return n;
+}
+
+// code points come in increasing order, so a partly covered page being
+// marked is always the newest one in the pool
+void mark_coverage( font_coverage &fc, uint16_t unicode16 ) {
+	uint8_t page = unicode16>>8;
+	fc.coarse[page] |= 1<<((unicode16&0xFF)>>5);
+	uint8_t state = page_state( fc, page );
+	if (state==COVERAGE_FULL || state==COVERAGE_UNKNOWN) return;
+	if (state==COVERAGE_EMPTY) {
+		if (fc.numpages==COVERAGE_MAX_PAGES) {
+			set_page_state( fc, page, COVERAGE_UNKNOWN );
+			return;
+		}
+		for (int i=0;i<32;i++) fc.bits[fc.numpages][i] = 0;
+		fc.numpages++;
+		set_page_state( fc, page, COVERAGE_PART );
+	}
+	fc.bits[fc.numpages-1][(unicode16&0xFF)>>3] |= 1<<(unicode16&7);
+}
+
+// walk every segment of the format 4 table once, marking each code point
+// that maps to a glyph other than 0 (the MISSING CHARACTER glyph).
+void build_coverage( fontinfo &fi, font_coverage &fc, FILE * f ) {
+	fc.numpages = 0;
+	for (int i=0;i<64;i++) fc.page[i] = COVERAGE_EMPTY;
+	for (int i=0;i<32;i++) fc.rank[i] = 0;
+	for (int i=0;i<256;i++) fc.coarse[i] = 0;
+	union uint16 format;
+	if (!seek_cmap_subtable( fi, format, f )) return;
+	if (format.uint16!=4) {
+		// cant read this table here, so let lookup_glyf_index decide
+		for (int i=0;i<64;i++) fc.page[i] = 0xFF; // all COVERAGE_UNKNOWN
+		for (int i=0;i<256;i++) fc.coarse[i] = 0xFF;
+		return;
+	}
+	union uint16 length, language, segCountX2;
+	read_uint16( length, f );
+	read_uint16( language, f );
+	read_uint16( segCountX2, f );
+	fseek( f, 6, SEEK_CUR ); // searchRange, entrySelector, rangeShift
+	uint32_t endcode_i = ftell( f );
+	uint32_t startcode_i = endcode_i + segCountX2.uint16 + 2; // reservedPad
+	uint32_t iddelta_i = startcode_i + segCountX2.uint16;
+	uint32_t idrangeoffset_i = iddelta_i + segCountX2.uint16;
+	union uint16 endcode, startcode, iddelta, idrangeoffset, tmp;
+	for (int i=0;i<segCountX2.uint16/2;i++) {
+		fseek( f, endcode_i, SEEK_SET );
+		read_uint16( endcode, f );
+		fseek( f, startcode_i, SEEK_SET );
+		read_uint16( startcode, f );
+		fseek( f, iddelta_i, SEEK_SET );
+		read_uint16( iddelta, f );
+		fseek( f, idrangeoffset_i, SEEK_SET );
+		read_uint16( idrangeoffset, f );
+		// the one code point in this segment whose delta wraps to glyph 0
+		uint16_t zero_unicode = 0x10000 - iddelta.uint16;
+		// 0xFFFF is the end-of-table marker, not a character
+		for (uint32_t c=startcode.uint16;c<=endcode.uint16 && c<0xFFFF;c++) {
+			if (idrangeoffset.uint16==0) {
+				bool whole_page = (c&0xFF)==0 && c+0xFF<=endcode.uint16;
+				if (whole_page && (c>>8)!=0xFF && (zero_unicode>>8)!=(c>>8)
+				 && page_state( fc, c>>8 )==COVERAGE_EMPTY) {
+					set_page_state( fc, c>>8, COVERAGE_FULL );
+					fc.coarse[c>>8] = 0xFF;
+					c += 0xFF;
+					continue;
+				}
+				if (((c+iddelta.uint16)&0xFFFF)!=0) mark_coverage( fc, c );
+			} else {
+				fseek( f, idrangeoffset_i + idrangeoffset.uint16 + 2*(c-startcode.uint16), SEEK_SET );
+				read_uint16( tmp, f );
+				if (tmp.uint16!=0) mark_coverage( fc, c );
+			}
+		}
+		endcode_i+=2;
+		startcode_i+=2;
+		iddelta_i+=2;
+		idrangeoffset_i+=2;
+	}
+	uint8_t n = 0;
+	for (int i=0;i<256;i++) {
+		if ((i&7)==0) fc.rank[i>>3] = n;
+		if (page_state( fc, i )==COVERAGE_PART) n++;
+	}
+}
+
+// false means the font surely has no glyph. true means it has one, or
+// that the page was unknown and the font's cmap must be asked.
+bool coverage_maybe( font_coverage &fc, uint32_t &unicode32 ) {
+	if (unicode32>0xFFFF) return false; // BMP only, see the top of the file
+	uint8_t page = unicode32>>8;
+	if (!(fc.coarse[page] & (1<<((unicode32&0xFF)>>5)))) return false;
+	uint8_t state = page_state( fc, page );
+	if (state==COVERAGE_FULL || state==COVERAGE_UNKNOWN) return true;
+	return fc.bits[page_bits( fc, page )][(unicode32&0xFF)>>3] & (1<<(unicode32&7));
+}
+
+// Fontset: an ordered fallback chain of opened fonts, for example
+// FreeSerif, then a CJK font, then a symbol font. The first font added is
+// the primary font, and supplies the MISSING CHARACTER glyph. Emoji fonts
+// keep their faces above 0xFFFF, which no font can resolve yet.
+#ifndef FONTSET_MAX_FONTS
+#define FONTSET_MAX_FONTS 3
+#endif
+
+typedef struct fontset_t {
+	uint8_t numfonts;
+	FILE * file[FONTSET_MAX_FONTS];
+	fontinfo fi[FONTSET_MAX_FONTS];
+	font_coverage coverage[FONTSET_MAX_FONTS];
+} fontset;
+
+void init_fontset( fontset &fs ) {
+	fs.numfonts = 0;
+}
+
+// add an opened font to the end of the chain. returns false if full.
+bool add_font( fontset &fs, FILE * f ) {
+	if (fs.numfonts==FONTSET_MAX_FONTS) return false;
+	uint8_t n = fs.numfonts;
+	fs.file[n] = f;
+	read_fontinfo( fs.fi[n], f );
+	build_coverage( fs.fi[n], fs.coverage[n], f );
+	fs.numfonts++;
+	return true;
+}
+
+// pick the first font in the chain that covers the unicode, and look up
+// the glyf index in that font only. if no font has it, return glyf 0 of
+// the primary font.
+void lookup_fontset_glyf( fontset &fs, uint32_t &unicode32, uint8_t &font_i, union uint32 &glyf_index ) {
+	font_i = 0;
+	glyf_index.uint32 = 0;
+	for (uint8_t i=0;i<fs.numfonts;i++) {
+		if (!coverage_maybe( fs.coverage[i], unicode32 )) continue;
+		lookup_glyf_index( fs.fi[i], unicode32, glyf_index, fs.file[i] );
+		if (glyf_index.uint32!=0) {
+			font_i = i;
+			return;
 		}
 	}
 }
@@ -609,6 +913,249 @@ void read_y_coord( union int16 &ydelta, uint8_t &flag, uint32_t &y_i, FILE *f ){
 
 void printglyfflag( uint8_t &f ); // forward declaration, here until refactor
 
+// Outline rasterizer.
+//
+// Points come out of do_glyf_data one at a time, and are never stored.
+// The 'pen' scales each one to the display, joins them into lines and
+// curves, and chops the curves into short lines ('edges'). Edges go into
+// a small table. Then, for each pixel row, we find where the edges cross
+// the middle of the row and fill between the crossings (nonzero winding
+// rule, like TrueType(TM) wants).
+//
+// Curves are chopped using the ball-in-the-air method from the top of this
+// file: position += velocity, velocity += acceleration, with the number of
+// steps a power of two so scaling is just shifts.
+//
+// Glyphs taller than BAND_HEIGHT rows are drawn in horizontal bands,
+// reading the outline again for each band, so the table only has to hold
+// one band's edges. If a band's edges still don't fit, the band is halved
+// and read again, down to a single row. Slow but small.
+
+// Display positions are in 'subpixels', fractions of a pixel.
+#define SUBPIXEL_SHIFT 4
+#define SUBPIXELS (1<<SUBPIXEL_SHIFT)
+
+#ifndef MAX_EDGES
+#define MAX_EDGES 64 // also the most crossings one pixel row can have
+#endif
+#ifndef BAND_HEIGHT
+#define BAND_HEIGHT 32 // pixel rows
+#endif
+
+// where rendered pixels go. x,y are display pixels, y grows downward.
+// only 'ink' pixels are sent, the display is assumed to be cleared.
+typedef void (*plot_fn)( int16_t x, int16_t y );
+
+// display rectangle in pixels. x1 and y1 are just outside of it.
+typedef struct rect_t {
+	int16_t x0;
+	int16_t y0;
+	int16_t x1;
+	int16_t y1;
+} rect;
+
+bool intersect( rect &a, rect &b, rect &out ) {
+	out.x0 = a.x0>b.x0 ? a.x0 : b.x0;
+	out.y0 = a.y0>b.y0 ? a.y0 : b.y0;
+	out.x1 = a.x1<b.x1 ? a.x1 : b.x1;
+	out.y1 = a.y1<b.y1 ? a.y1 : b.y1;
+	return out.x0<out.x1 && out.y0<out.y1;
+}
+
+// Orientation. Panels are often mounted turned relative to the way their
+// controller scans. Rather than rotating a finished bitmap (which needs a
+// second buffer), the point coordinates are swapped or negated as
+// do_glyf_data decodes them, and layout advances are turned the same way.
+// Then text comes out already in the panel's own row order. Rotation is
+// clockwise as seen on the display. Mirroring flips left and right, and
+// happens before rotating.
+#define ORIENT_0      0
+#define ORIENT_90     1
+#define ORIENT_180    2
+#define ORIENT_270    3
+#define ORIENT_MIRROR 4
+
+// turn a display offset (x right, y down) the way the panel is mounted
+void orient_offset( uint8_t orient, int32_t &x, int32_t &y ) {
+	int32_t tmp;
+	if (orient & ORIENT_MIRROR) x = -x;
+	switch (orient & 3) {
+	case ORIENT_90: tmp = x; x = -y; y = tmp; break;
+	case ORIENT_180: x = -x; y = -y; break;
+	case ORIENT_270: tmp = x; x = y; y = -tmp; break;
+	}
+}
+
+// same, for a point in font units, where y goes up
+void orient_point( uint8_t orient, int16_t &fx, int16_t &fy ) {
+	int32_t x = fx, y = -fy;
+	orient_offset( orient, x, y );
+	fx = x;
+	fy = -y;
+}
+
+// move x,y from where the top left corner of a w by h box (subpixels)
+// should land on the display, to where the box starts before turning
+void turned_origin( uint8_t orient, int32_t w, int32_t h, int32_t &x, int32_t &y ) {
+	orient_offset( orient, w, h );
+	if (w<0) x -= w;
+	if (h<0) y -= h;
+}
+
+// pixel box holding the rectangle from (x0,y0) to (x1,y1), given as
+// subpixel offsets from x,y before turning
+void oriented_box( uint8_t orient, int32_t x, int32_t y, int32_t x0, int32_t y0, int32_t x1, int32_t y1, rect &box ) {
+	orient_offset( orient, x0, y0 );
+	orient_offset( orient, x1, y1 );
+	box.x0 = (x + (x0<x1 ? x0 : x1)) >> SUBPIXEL_SHIFT;
+	box.x1 = ((x + (x0<x1 ? x1 : x0)) >> SUBPIXEL_SHIFT) + 1;
+	box.y0 = (y + (y0<y1 ? y0 : y1)) >> SUBPIXEL_SHIFT;
+	box.y1 = ((y + (y0<y1 ? y1 : y0)) >> SUBPIXEL_SHIFT) + 1;
+}
+
+typedef struct edge_t {
+	int16_t x0, y0; // subpixels. y0 < y1 always
+	int16_t x1, y1;
+	int8_t dir; // +1 if the outline runs downward here, -1 if upward
+} edge;
+
+typedef struct edge_table_t {
+	int16_t band_y0, band_y1; // subpixels. edges outside are dropped
+	uint16_t numedges;
+	bool overflow;
+	edge e[MAX_EDGES];
+} edge_table;
+
+// the pen follows one contour at a time. TrueType(TM) contours are on-curve
+// points with off-curve control points between them. two off-curve points
+// in a row have an implied on-curve point halfway between them.
+typedef struct outline_pen_t {
+	uint8_t ppem;
+	uint8_t orient; // ORIENT_ value
+	uint16_t unitsPerEm;
+	int32_t ox, oy; // glyph origin (on baseline) in subpixels
+	uint16_t n; // number of points seen in this contour
+	bool first_off; // contour began with an off-curve point, saved in f
+	bool has_ctrl; // q is a pending control point
+	int32_t sx, sy; // start of contour (on curve)
+	int32_t cx, cy; // current position (on curve)
+	int32_t qx, qy; // pending control point
+	int32_t fx, fy; // first point, if it was off curve
+} outline_pen;
+
+void init_pen( outline_pen &pen, fontinfo &fi, uint8_t ppem, uint8_t orient, int32_t x, int32_t y ) {
+	pen.ppem = ppem;
+	pen.orient = orient;
+	pen.unitsPerEm = fi.head_table_unitsPerEm.uint16;
+	pen.ox = x;
+	pen.oy = y;
+	pen.n = 0;
+}
+
+void add_edge( edge_table &et, int32_t x0, int32_t y0, int32_t x1, int32_t y1 ) {
+	int8_t dir = 1;
+	if (y0==y1) return; // horizontal edges never cross a row's middle
+	if (y0>y1) {
+		int32_t tmp;
+		tmp = x0; x0 = x1; x1 = tmp;
+		tmp = y0; y0 = y1; y1 = tmp;
+		dir = -1;
+	}
+	// only keep edges crossing the middle of some row in the band
+	if (y1<=et.band_y0+SUBPIXELS/2 || y0>et.band_y1-SUBPIXELS/2) return;
+	if (et.numedges==MAX_EDGES) {
+		et.overflow = true;
+		return;
+	}
+	edge &e = et.e[et.numedges++];
+	e.x0 = x0; e.y0 = y0;
+	e.x1 = x1; e.y1 = y1;
+	e.dir = dir;
+}
+
+// quadratic bezier from c through control q to p, in 2^shift steps.
+// positions are kept scaled up by 2^(2*shift) so there are no fractions.
+void add_curve( edge_table &et, int32_t cx, int32_t cy, int32_t qx, int32_t qy, int32_t px, int32_t py ) {
+	int32_t ax = cx - 2*qx + px; // acceleration, times 2^(2*shift) / 2
+	int32_t ay = cy - 2*qy + py;
+	int32_t bend = ax<0 ? -ax : ax;
+	if (ay>bend) bend = ay;
+	else if (-ay>bend) bend = -ay;
+	// error of n straight steps is bend/(4*n*n). keep it under 1/4 pixel.
+	uint8_t shift = 0;
+	while (shift<4 && (SUBPIXELS<<(2*shift)) < bend) shift++;
+	int32_t xpos = cx<<(2*shift), ypos = cy<<(2*shift);
+	int32_t xvel = ((qx-cx)<<(shift+1)) + ax, yvel = ((qy-cy)<<(shift+1)) + ay;
+	int32_t round = (1<<(2*shift))>>1;
+	int32_t lastx = cx, lasty = cy;
+	for (int i=1;i<(1<<shift);i++) {
+		xpos += xvel; xvel += 2*ax;
+		ypos += yvel; yvel += 2*ay;
+		int32_t x = (xpos+round)>>(2*shift);
+		int32_t y = (ypos+round)>>(2*shift);
+		add_edge( et, lastx, lasty, x, y );
+		lastx = x; lasty = y;
+	}
+	add_edge( et, lastx, lasty, px, py );
+}
+
+// font units to subpixels, with y flipped so it grows downward
+void pen_point( outline_pen &pen, edge_table &et, int16_t fx, int16_t fy, bool on_curve ) {
+	int32_t x = pen.ox + (int32_t)fx * pen.ppem * SUBPIXELS / pen.unitsPerEm;
+	int32_t y = pen.oy - (int32_t)fy * pen.ppem * SUBPIXELS / pen.unitsPerEm;
+	if (pen.n==0) {
+		pen.has_ctrl = false;
+		pen.first_off = !on_curve;
+		if (on_curve) { pen.sx = pen.cx = x; pen.sy = pen.cy = y; }
+		else { pen.fx = x; pen.fy = y; }
+	} else if (pen.n==1 && pen.first_off) {
+		if (on_curve) {
+			pen.sx = pen.cx = x; pen.sy = pen.cy = y;
+		} else {
+			pen.sx = pen.cx = (pen.fx+x)/2;
+			pen.sy = pen.cy = (pen.fy+y)/2;
+			pen.qx = x; pen.qy = y;
+			pen.has_ctrl = true;
+		}
+	} else if (on_curve) {
+		if (pen.has_ctrl) add_curve( et, pen.cx, pen.cy, pen.qx, pen.qy, x, y );
+		else add_edge( et, pen.cx, pen.cy, x, y );
+		pen.cx = x; pen.cy = y;
+		pen.has_ctrl = false;
+	} else {
+		if (pen.has_ctrl) {
+			int32_t mx = (pen.qx+x)/2, my = (pen.qy+y)/2;
+			add_curve( et, pen.cx, pen.cy, pen.qx, pen.qy, mx, my );
+			pen.cx = mx; pen.cy = my;
+		}
+		pen.qx = x; pen.qy = y;
+		pen.has_ctrl = true;
+	}
+	pen.n++;
+}
+
+// join the end of the contour back to its start
+void pen_close( outline_pen &pen, edge_table &et ) {
+	if (pen.n<2) {
+		pen.n = 0;
+		return;
+	}
+	if (pen.first_off) {
+		// the contour has to pass through the saved first point
+		if (pen.has_ctrl) {
+			int32_t mx = (pen.qx+pen.fx)/2, my = (pen.qy+pen.fy)/2;
+			add_curve( et, pen.cx, pen.cy, pen.qx, pen.qy, mx, my );
+			pen.cx = mx; pen.cy = my;
+		}
+		add_curve( et, pen.cx, pen.cy, pen.fx, pen.fy, pen.sx, pen.sy );
+	} else if (pen.has_ctrl) {
+		add_curve( et, pen.cx, pen.cy, pen.qx, pen.qy, pen.sx, pen.sy );
+	} else {
+		add_edge( et, pen.cx, pen.cy, pen.sx, pen.sy );
+	}
+	pen.n = 0;
+}
+
 // read a flag. sounds easy but is complicated.
 // flags are sort of 'run length encoded' so you have to deal with repeats (runs)
 void readflag( uint8_t &flag, uint32_t &flags_i, uint8_t &repeat_counter, FILE *f ) {
@@ -623,8 +1170,12 @@ void readflag( uint8_t &flag, uint32_t &flags_i, uint8_t &repeat_counter, FILE *
 	}
 }
 
-// refacccctor
-void do_glyf_data( glyf_description &gd, FILE *f, uint32_t glyfdataoffset ){
+// walk every point of a simple glyf, handing each to the pen
+#ifdef MEASURE
+uint32_t outline_reads; // by do_glyf_data, for the harness at the end
+#endif
+
+void do_glyf_data( glyf_description &gd, FILE *f, uint32_t glyfdataoffset, outline_pen &pen, edge_table &et ){
 	// flag - explanation of 'xshort' and 'x-is-same/xshort-positive' bits.
 	// bit1 bit4 result (truth table)
 	// 1    0    x is 8bit value, sign is negative (9bit signed int)
@@ -633,6 +1184,10 @@ void do_glyf_data( glyf_description &gd, FILE *f, uint32_t glyfdataoffset ){
 	// 0    1    x is the same as the previous x coordinate
 
 	if (gd.numberOfContours.int16<0) return; // sient fail on compound glyfs
+	if (gd.numberOfContours.int16==0) return;
+#ifdef MEASURE
+	outline_reads++;
+#endif
 	fseek(f,glyfdataoffset,SEEK_SET);
 	uint16_t num_points;
 
@@ -644,10 +1199,14 @@ void do_glyf_data( glyf_description &gd, FILE *f, uint32_t glyfdataoffset ){
 	union uint16 endpt_index;
 	for (int i=0;i<gd.numberOfContours.int16;i++) {
 		read_uint16( endpt_index, f );
+#ifdef DEBUG
 		printf("contour %i endpt idx: %i\n", i, endpt_index.uint16);
+#endif
 	}
 	num_points = endpt_index.uint16+1;
+#ifdef DEBUG
 	printf("total number of points: %i\n", num_points);
+#endif
 
 	// skip "instructions" section
 	union uint16 instructionLength;
@@ -682,32 +1241,1036 @@ void do_glyf_data( glyf_description &gd, FILE *f, uint32_t glyfdataoffset ){
 	flags_i = flags_offset;
 
 	// step two. we have flag_i, x_i, y_i all set up. process the points.
-	int16_t xcursor,ycursor;
+	// coordinates are deltas, the cursor adds them up. a run of repeated
+	// flags can carry on into the next contour, so repeat_counter is not
+	// reset between contours.
+	int16_t xcursor = 0, ycursor = 0;
 	union int16 xdelta,ydelta;
 	glyf_point gp;
+#ifdef DEBUG
 	printf("idx endp %i flg %i x %i y %i\n",endpts_i,flags_i,x_i,y_i);
+#endif
 	union uint16 prev_endpt_index;
 	prev_endpt_index.uint16 = 0;
+	repeat_counter = 0;
 	for (int i=0;i<gd.numberOfContours.int16;i++){
 		fseek( f, endpts_i, SEEK_SET );
 		read_uint16( endpt_index, f );
 		endpts_i = ftell(f);
-		repeat_counter = 0;
+		gp.endPtIndex = endpt_index;
 		for (int j=prev_endpt_index.uint16;j<endpt_index.uint16+1;j++) {
 			readflag( flag, flags_i, repeat_counter, f );
 			read_x_coord( xdelta, flag, x_i, f );
 			read_y_coord( ydelta, flag, y_i, f );
+			xcursor += xdelta.int16;
+			ycursor += ydelta.int16;
+			gp.flag = flag;
+			gp.xCoord.int16 = xcursor;
+			gp.yCoord.int16 = ycursor;
+			orient_point( pen.orient, gp.xCoord.int16, gp.yCoord.int16 );
+			pen_point( pen, et, gp.xCoord.int16, gp.yCoord.int16, gp.flag & GF_ON_CURVE );
+#ifdef DEBUG
 			printf("idxes: endp %i flg %i x %i y %i\n",endpts_i,flags_i,x_i,y_i);
 			printf("-\\\n");
 			printf("contour idx %i point idx %i\n",i,j);
 			printglyfflag( flag );
 			printf("xdelta %i \t ydelta %i \n", xdelta.int16, ydelta.int16 );
 			printf("-/\n");
+#endif
 		}
+		pen_close( pen, et );
 		prev_endpt_index.uint16 = endpt_index.uint16+1;
 	}
 }
 
+// fill the pixels of one row whose middles lie between the crossings, using
+// the nonzero winding rule.
+void scan_edges( edge_table &et, int16_t row, rect &clip, plot_fn plot ) {
+	int16_t cross_x[MAX_EDGES]; // every edge crosses a row at most once
+	int8_t cross_dir[MAX_EDGES];
+	uint16_t n = 0;
+	int32_t y = row*SUBPIXELS + SUBPIXELS/2;
+	for (uint16_t i=0;i<et.numedges;i++) {
+		edge &e = et.e[i];
+		if (y<e.y0 || y>=e.y1) continue;
+		int16_t x = e.x0 + (int32_t)(y-e.y0)*(e.x1-e.x0)/(e.y1-e.y0);
+		// insertion sort, there are only a few crossings
+		uint16_t k = n++;
+		while (k>0 && cross_x[k-1]>x) {
+			cross_x[k] = cross_x[k-1];
+			cross_dir[k] = cross_dir[k-1];
+			k--;
+		}
+		cross_x[k] = x;
+		cross_dir[k] = e.dir;
+	}
+	int8_t winding = 0;
+	int16_t span_x = 0;
+	for (uint16_t k=0;k<n;k++) {
+		if (winding==0) span_x = cross_x[k];
+		winding += cross_dir[k];
+		if (winding!=0) continue;
+		// pixel px is filled if its middle, px*SUBPIXELS+SUBPIXELS/2,
+		// is inside [span_x, cross_x[k])
+		int16_t px0 = (span_x + SUBPIXELS/2 - 1) >> SUBPIXEL_SHIFT;
+		int16_t px1 = (cross_x[k] + SUBPIXELS/2 - 1) >> SUBPIXEL_SHIFT;
+		if (px0<clip.x0) px0 = clip.x0;
+		if (px1>clip.x1) px1 = clip.x1;
+		for (int16_t px=px0;px<px1;px++) plot( px, row );
+	}
+}
+
+// pixel bounding box of a glyf whose origin is at x,y (subpixels)
+void glyf_pixel_box( fontinfo &fi, glyf_description &gd, uint8_t ppem, uint8_t orient, int32_t x, int32_t y, rect &box ) {
+	int32_t s = ppem * SUBPIXELS;
+	uint16_t upem = fi.head_table_unitsPerEm.uint16;
+	oriented_box( orient, x, y,
+	 gd.xMin.int16 * s / upem, -gd.yMax.int16 * s / upem,
+	 gd.xMax.int16 * s / upem, -gd.yMin.int16 * s / upem, box );
+}
+
+// find a glyf and read its description (bounding box). returns false for
+// an empty glyf, like space, which has no description at all. otherwise
+// glyfdataoffset is where its contours begin.
+bool read_glyf_header( fontinfo &fi, union uint32 &glyf_index, glyf_description &gd, uint32_t &glyfdataoffset, FILE * f ) {
+	union uint32 glyf_offset, next_offset, next_index;
+	next_index.uint32 = glyf_index.uint32 + 1;
+	lookup_glyf_offset( fi, glyf_index, glyf_offset, f );
+	lookup_glyf_offset( fi, next_index, next_offset, f );
+	if (glyf_offset.uint32==next_offset.uint32) return false;
+	fseek( f, fi.glyf_table_offset.uint32 + glyf_offset.uint32, SEEK_SET );
+	read_glyf_description( gd, f );
+	glyfdataoffset = ftell(f);
+	return true;
+}
+
+// rasterize an outline glyf with its origin at x,y (subpixels). only
+// pixels inside clip are drawn, and if the glyf's bounding box is outside
+// of clip, its points are not even read. returns false if a single row
+// had more than MAX_EDGES edges, then that row is drawn wrong.
+bool render_outline_glyf( fontinfo &fi, union uint32 &glyf_index, uint8_t ppem, uint8_t orient, int32_t x, int32_t y, rect &clip, plot_fn plot, FILE * f ) {
+	glyf_description gd;
+	uint32_t glyfdataoffset;
+	if (!read_glyf_header( fi, glyf_index, gd, glyfdataoffset, f )) return true;
+	rect box, area;
+	glyf_pixel_box( fi, gd, ppem, orient, x, y, box );
+	if (!intersect( box, clip, area )) return true;
+
+	edge_table et;
+	outline_pen pen;
+	bool ok = true;
+	int16_t band_height = BAND_HEIGHT;
+	int16_t band = area.y0;
+	while (band<area.y1) {
+		int16_t band_end = band+band_height<area.y1 ? band+band_height : area.y1;
+		et.band_y0 = band*SUBPIXELS;
+		et.band_y1 = band_end*SUBPIXELS;
+		et.numedges = 0;
+		et.overflow = false;
+		init_pen( pen, fi, ppem, orient, x, y );
+		do_glyf_data( gd, f, glyfdataoffset, pen, et );
+		if (et.overflow && band_height>1) {
+			band_height /= 2; // too many edges, try again with fewer rows
+			continue;
+		}
+		if (et.overflow) ok = false;
+		for (int16_t row=band;row<band_end;row++) scan_edges( et, row, area, plot );
+		band = band_end;
+	}
+	return ok;
+}
+
+// Metrics. To wrap a paragraph we only need to know how wide each glyph is,
+// which is in the hmtx table. Measuring never touches the glyf points, so
+// it costs a cmap lookup and one or two small reads per character.
+// https://developer.apple.com/fonts/TrueType-Reference-Manual/RM06/Chap6hmtx.html
+//
+// Layout positions are in subpixels too, so that rounding errors don't
+// pile up along a line.
+
+typedef struct glyf_metrics_t {
+	union uint16 advanceWidth;
+	union int16 leftSideBearing;
+	glyf_description gd; // only filled in if asked for
+} glyf_metrics;
+
+// font units to subpixels, at ppem pixels per em
+int32_t scale_funits( fontinfo &fi, int32_t v, uint8_t ppem ) {
+	return v * ppem * SUBPIXELS / fi.head_table_unitsPerEm.uint16;
+}
+
+// hmtx holds numberOfHMetrics pairs of (advance, lsb). glyphs past the end
+// (usually monospaced ones) reuse the last advance, and have only an lsb.
+// with_bbox also reads the glyf header (bounding box), but not the points.
+void measure_glyf( fontinfo &fi, union uint32 &glyf_index, glyf_metrics &gm, bool with_bbox, FILE * f ) {
+	uint16_t n = fi.hhea_table_numberOfHMetrics.uint16;
+	if (glyf_index.uint32<n) {
+		fseek( f, fi.hmtx_table_offset.uint32 + 4*glyf_index.uint32, SEEK_SET );
+		read_uint16( gm.advanceWidth, f );
+		read_int16( gm.leftSideBearing, f );
+	} else {
+		fseek( f, fi.hmtx_table_offset.uint32 + 4*(n-1), SEEK_SET );
+		read_uint16( gm.advanceWidth, f );
+		fseek( f, fi.hmtx_table_offset.uint32 + 4*n + 2*(glyf_index.uint32-n), SEEK_SET );
+		read_int16( gm.leftSideBearing, f );
+	}
+	if (!with_bbox) return;
+	uint32_t glyfdataoffset;
+	if (!read_glyf_header( fi, glyf_index, gm.gd, glyfdataoffset, f )) {
+		gm.gd.numberOfContours.int16 = 0;
+		gm.gd.xMin.int16 = gm.gd.yMin.int16 = 0;
+		gm.gd.xMax.int16 = gm.gd.yMax.int16 = 0;
+	}
+}
+
+// advance width of a unicode character in subpixels, using whichever font
+// of the fontset has it.
+int32_t measure_unicode( fontset &fs, uint32_t &unicode32, uint8_t ppem ) {
+	uint8_t font_i;
+	union uint32 glyf_index;
+	glyf_metrics gm;
+	lookup_fontset_glyf( fs, unicode32, font_i, glyf_index );
+	measure_glyf( fs.fi[font_i], glyf_index, gm, false, fs.file[font_i] );
+	return scale_funits( fs.fi[font_i], gm.advanceWidth.uint16, ppem );
+}
+
+// Line breaking. Greedy: put as many words on a line as fit, break after
+// a space, or mid-word if a single word is wider than the line. A newline
+// always ends a line. Spaces at the end of a line 'hang' past the margin
+// and are not counted in its width.
+//
+// Text is an array of unicode code points owned by the caller. Line i
+// covers text from line_start[i] up to line_start[i+1] (or the end).
+// After an edit, reflow_text only measures lines from the one before the
+// edit, until a line break lands where an old one did, after the edit.
+// The remaining lines are then just shifted.
+#ifndef LAYOUT_MAX_LINES
+#define LAYOUT_MAX_LINES 32
+#endif
+
+typedef struct text_layout_t {
+	uint8_t ppem;
+	int32_t max_width; // subpixels
+	uint16_t numlines;
+	uint16_t line_start[LAYOUT_MAX_LINES];
+	int32_t line_width[LAYOUT_MAX_LINES]; // subpixels
+} text_layout;
+
+// measure one line beginning at start. next is where the following line
+// begins.
+void break_line( fontset &fs, uint32_t *text, uint16_t len, uint16_t start, text_layout &tl, uint16_t &next, int32_t &width ) {
+	int32_t w = 0;
+	uint16_t break_i = 0;
+	int32_t break_w = 0;
+	for (uint16_t i=start;i<len;i++) {
+		if (text[i]=='\n') {
+			next = i+1;
+			width = w;
+			return;
+		}
+		if (text[i]==' ') {
+			break_i = i+1;
+			break_w = w;
+		}
+		int32_t advance = measure_unicode( fs, text[i], tl.ppem );
+		if (w+advance>tl.max_width && i>start && text[i]!=' ') {
+			if (break_i>start) {
+				next = break_i;
+				width = break_w;
+			} else {
+				next = i;
+				width = w;
+			}
+			return;
+		}
+		w += advance;
+	}
+	next = len;
+	width = w;
+}
+
+// text[pos] up to text[pos+old_n] was replaced by new_n code points. text
+// and len are the new text. the old lines after the edit are parked at
+// the top of the arrays while new lines are written from the bottom.
+void reflow_text( fontset &fs, uint32_t *text, uint16_t len, uint16_t pos, uint16_t old_n, uint16_t new_n, text_layout &tl ) {
+	uint16_t first = 0;
+	while (first+1<tl.numlines && tl.line_start[first+1]<=pos) first++;
+	// a word broken over several lines starts on the first of them. the
+	// text before line_start[first] is unchanged, so it can be checked.
+	while (first>0 && text[tl.line_start[first]-1]!=' ' && text[tl.line_start[first]-1]!='\n') first--;
+	// deleting from a word may let it move up to the line before
+	if (first>0) first--;
+
+	// a full layout may have been cut short, so past the last parked line
+	// there can be more text to lay out
+	bool was_full = tl.numlines==LAYOUT_MAX_LINES;
+	uint16_t tail_n = tl.numlines>first+1 ? tl.numlines-first-1 : 0;
+	uint16_t tail_i = LAYOUT_MAX_LINES - tail_n;
+	for (uint16_t i=tail_n;i>0;i--) {
+		uint16_t start = tl.line_start[first+i];
+		// a line that began inside the edit can never match again
+		if (start>=pos+old_n) start = start - old_n + new_n;
+		else start = 0;
+		tl.line_start[tail_i+i-1] = start;
+		tl.line_width[tail_i+i-1] = tl.line_width[first+i];
+	}
+
+	uint16_t j = first;
+	uint16_t start = tl.line_start[first];
+	uint16_t next;
+	while (j<LAYOUT_MAX_LINES) {
+		if (j==tail_i) tail_i++; // new lines caught up, give up that old one
+		tl.line_start[j] = start;
+		break_line( fs, text, len, start, tl, next, tl.line_width[j] );
+		j++;
+		if (next>=len) break;
+		while (tail_i<LAYOUT_MAX_LINES && tl.line_start[tail_i]<next) tail_i++;
+		if (tail_i<LAYOUT_MAX_LINES && tl.line_start[tail_i]==next) {
+			// same break as before, the rest of the lines are unchanged
+			while (tail_i<LAYOUT_MAX_LINES) {
+				tl.line_start[j] = tl.line_start[tail_i];
+				tl.line_width[j] = tl.line_width[tail_i];
+				j++;
+				tail_i++;
+			}
+			if (!was_full || j==LAYOUT_MAX_LINES) break;
+			// lines were saved, so carry on from the old last line
+			j--;
+			next = tl.line_start[j];
+		}
+		start = next;
+	}
+	tl.numlines = j; // if we ran out of lines, the rest is not laid out
+}
+
+void layout_text( fontset &fs, uint32_t *text, uint16_t len, uint8_t ppem, int32_t max_width, text_layout &tl ) {
+	tl.ppem = ppem;
+	tl.max_width = max_width;
+	tl.numlines = 1;
+	tl.line_start[0] = 0;
+	reflow_text( fs, text, len, 0, 0, 0, tl );
+}
+
+// Line renderer, for displays that want their data one pixel row at a
+// time, like most SPI display controllers.
+//
+// Instead of drawing glyph by glyph into a frame buffer, the edges of every
+// glyph on a text line go into one edge table, sorted from top to bottom.
+// Then the line is scanned row by row. Edges join an 'active' list when
+// the row reaches their top and leave it after their bottom. The active
+// edges are kept sorted left to right, and the row between them is filled
+// in one bit per pixel. Each finished row, the whole width of the display,
+// goes to a callback. Only one row is ever in memory.
+//
+// Where each glyph goes and its bounding box are found once per line, for
+// the first LINE_MAX_GLYFS glyphs. Glyphs past those are looked up again
+// every time the line's edges are collected.
+//
+// If the line is taller than BAND_HEIGHT, or its edges don't fit in the
+// table, the line is done in bands. Only the outlines that touch a band are
+// read for it, so a glyph is read once per band it crosses. A band that
+// overflows is tried again half as tall, and the next band is sized from
+// how full the table got, up to BAND_HEIGHT again. A long line can cross
+// more edges in a single row than the table holds. Then that row is done in
+// slices from left to right, each with only the glyphs whose box touches
+// it. A glyph's closed contours add up to no winding outside its box, so
+// leaving the others out changes nothing inside the slice. A slice ends
+// where the first glyph that didn't fit begins, so what was read for it is
+// all used.
+//
+// Bitmap strikes are not used here, every glyph is drawn from its outline.
+// A strike would have to be read back one row at a time for each glyph, a
+// seek per glyph per row, or per pixel when turned. So at a size the font
+// has a strike for, render_glyf and this can draw a glyph differently.
+#ifndef ROW_WIDTH
+#define ROW_WIDTH 400 // pixels across the display
+#endif
+#define ROW_BYTES ((ROW_WIDTH+7)/8)
+#ifndef LINE_MAX_GLYFS
+#define LINE_MAX_GLYFS 32 // 20 bytes each, on the stack
+#endif
+
+// one pixel row. bit 7 of row[0] is the leftmost pixel, 1 is ink.
+typedef void (*row_fn)( int16_t y, uint8_t *row );
+
+typedef struct line_glyf_t {
+	uint8_t font_i; // in the fontset
+	int16_t numberOfContours; // 0 for no outline
+	uint32_t glyfdataoffset;
+	int32_t advance; // subpixels along the line to its origin, before turning
+	rect box; // pixels
+} line_glyf;
+
+typedef struct line_glyfs_t {
+	uint16_t numglyfs;
+	uint16_t rest; // index in text of the first glyph not in g
+	int32_t rest_advance;
+	line_glyf g[LINE_MAX_GLYFS];
+} line_glyfs;
+
+typedef struct active_edge_t {
+	uint16_t e; // index in the edge table
+	int16_t x; // where it crosses the middle of the current row
+} active_edge;
+
+// sort edges by their top. insertion sort: small code, and glyphs tend
+// to add edges in runs that are already in order.
+void sort_edges( edge_table &et ) {
+	for (uint16_t i=1;i<et.numedges;i++) {
+		edge tmp = et.e[i];
+		uint16_t k = i;
+		while (k>0 && et.e[k-1].y0>tmp.y0) {
+			et.e[k] = et.e[k-1];
+			k--;
+		}
+		et.e[k] = tmp;
+	}
+}
+
+// set pixels [px0,px1) in a row
+void fill_row( uint8_t *row, int16_t px0, int16_t px1 ) {
+	if (px0<0) px0 = 0;
+	if (px1>ROW_WIDTH) px1 = ROW_WIDTH;
+	for (int16_t px=px0;px<px1;px++) row[px>>3] |= 0x80>>(px&7);
+}
+
+// scan rows [y0,y1) of a sorted edge table into row, setting only the
+// pixels in [x0,x1). each row is cleared before and sent to emit after,
+// unless emit is 0, then the caller does that.
+void scan_rows( edge_table &et, int16_t y0, int16_t y1, int16_t x0, int16_t x1, uint8_t *row, row_fn emit ) {
+	active_edge active[MAX_EDGES]; // never more than are in the table
+	uint16_t numactive = 0;
+	uint16_t next = 0;
+	for (int16_t r=y0;r<y1;r++) {
+		int32_t y = r*SUBPIXELS + SUBPIXELS/2;
+		// drop edges that ended above this row's middle
+		uint16_t k = 0;
+		for (uint16_t i=0;i<numactive;i++) {
+			if (et.e[active[i].e].y1>y) active[k++] = active[i];
+		}
+		numactive = k;
+		// pick up edges that begin at or above it
+		while (next<et.numedges && et.e[next].y0<=y) {
+			if (et.e[next].y1>y) active[numactive++].e = next;
+			next++;
+		}
+		// find crossings and keep them sorted left to right. they move
+		// only a little from row to row, so this is nearly no work.
+		for (uint16_t i=0;i<numactive;i++) {
+			edge &e = et.e[active[i].e];
+			active_edge a = active[i];
+			a.x = e.x0 + (int32_t)(y-e.y0)*(e.x1-e.x0)/(e.y1-e.y0);
+			k = i;
+			while (k>0 && active[k-1].x>a.x) {
+				active[k] = active[k-1];
+				k--;
+			}
+			active[k] = a;
+		}
+		if (emit) {
+			for (int i=0;i<ROW_BYTES;i++) row[i] = 0;
+		}
+		int8_t winding = 0;
+		int16_t span_x = 0;
+		for (uint16_t i=0;i<numactive;i++) {
+			if (winding==0) span_x = active[i].x;
+			winding += et.e[active[i].e].dir;
+			if (winding!=0) continue;
+			int16_t px0 = (span_x + SUBPIXELS/2 - 1) >> SUBPIXEL_SHIFT;
+			int16_t px1 = (active[i].x + SUBPIXELS/2 - 1) >> SUBPIXEL_SHIFT;
+			fill_row( row, px0>x0 ? px0 : x0, px1<x1 ? px1 : x1 );
+		}
+		if (emit) emit( r, row );
+	}
+}
+
+// find the glyph for c and its box. advance is where it goes along the
+// line, and is moved past it. x,y is the start of the baseline.
+void place_line_glyf( fontset &fs, uint32_t c, uint8_t ppem, uint8_t orient, int32_t x, int32_t y, int32_t &advance, line_glyf &lg ) {
+	union uint32 glyf_index;
+	glyf_metrics gm;
+	lookup_fontset_glyf( fs, c, lg.font_i, glyf_index );
+	fontinfo &fi = fs.fi[lg.font_i];
+	FILE * f = fs.file[lg.font_i];
+	measure_glyf( fi, glyf_index, gm, false, f );
+	lg.advance = advance;
+	lg.numberOfContours = 0;
+	if (read_glyf_header( fi, glyf_index, gm.gd, lg.glyfdataoffset, f )) {
+		int32_t gx = advance, gy = 0;
+		orient_offset( orient, gx, gy );
+		glyf_pixel_box( fi, gm.gd, ppem, orient, x+gx, y+gy, lg.box );
+		lg.numberOfContours = gm.gd.numberOfContours.int16;
+	}
+	advance += scale_funits( fi, gm.advanceWidth.uint16, ppem );
+}
+
+// place the first LINE_MAX_GLYFS glyphs of line line_i
+void place_line( fontset &fs, uint32_t *text, uint16_t len, text_layout &tl, uint16_t line_i, uint8_t orient, int32_t x, int32_t y, line_glyfs &lgs ) {
+	uint16_t end = line_i+1<tl.numlines ? tl.line_start[line_i+1] : len;
+	int32_t advance = 0;
+	uint16_t i = tl.line_start[line_i];
+	lgs.numglyfs = 0;
+	for (;i<end && lgs.numglyfs<LINE_MAX_GLYFS;i++) {
+		if (text[i]=='\n') continue;
+		place_line_glyf( fs, text[i], tl.ppem, orient, x, y, advance, lgs.g[lgs.numglyfs++] );
+	}
+	lgs.rest = i;
+	lgs.rest_advance = advance;
+}
+
+// does a placed glyph have ink in the band, in the pixel columns from x0
+// to x1
+bool line_glyf_in( line_glyf &lg, edge_table &et, int16_t x0, int16_t x1 ) {
+	if (lg.numberOfContours==0) return false;
+	rect &box = lg.box;
+	if (box.y1*SUBPIXELS<=et.band_y0 || box.y0*SUBPIXELS>=et.band_y1) return false;
+	return box.x1>x0 && box.x0<x1;
+}
+
+// read the outline of a placed glyph into the table
+void add_glyf_edges( fontset &fs, line_glyf &lg, uint8_t ppem, uint8_t orient, int32_t x, int32_t y, edge_table &et ) {
+	int32_t gx = lg.advance, gy = 0;
+	orient_offset( orient, gx, gy );
+	outline_pen pen;
+	init_pen( pen, fs.fi[lg.font_i], ppem, orient, x+gx, y+gy );
+	glyf_description gd;
+	gd.numberOfContours.int16 = lg.numberOfContours;
+	do_glyf_data( gd, fs.file[lg.font_i], lg.glyfdataoffset, pen, et );
+}
+
+// add one glyph of a line to the table, see add_line_edges
+void add_line_glyf( fontset &fs, line_glyf &lg, uint8_t ppem, uint8_t orient, int32_t x, int32_t y, int16_t x0, int16_t x1, edge_table &et, uint16_t &before, int16_t &cut ) {
+	if (!line_glyf_in( lg, et, x0, x1 )) return;
+	if (et.overflow) {
+		if (lg.box.x0<cut) cut = lg.box.x0;
+		return;
+	}
+	before = et.numedges;
+	add_glyf_edges( fs, lg, ppem, orient, x, y, et );
+	if (et.overflow) cut = lg.box.x0;
+}
+
+// put the edges of every glyph on line line_i into the table, for the rows
+// from band_y0 to band_y1 and the pixel columns from x0 to x1. x,y is the
+// start of the baseline, lgs is from place_line. if the table overflows,
+// the glyph that didn't fit is taken out again, and no more outlines are
+// read. cut is then the left side of the leftmost glyph not in the table,
+// so the table holds every edge the columns from x0 to cut need.
+void add_line_edges( fontset &fs, uint32_t *text, uint16_t len, text_layout &tl, uint16_t line_i, uint8_t orient, int32_t x, int32_t y, line_glyfs &lgs, int16_t x0, int16_t x1, edge_table &et, int16_t &cut ) {
+	uint16_t before = 0;
+	cut = x1;
+	for (uint16_t k=0;k<lgs.numglyfs;k++) {
+		add_line_glyf( fs, lgs.g[k], tl.ppem, orient, x, y, x0, x1, et, before, cut );
+	}
+	uint16_t end = line_i+1<tl.numlines ? tl.line_start[line_i+1] : len;
+	int32_t advance = lgs.rest_advance;
+	line_glyf lg;
+	for (uint16_t i=lgs.rest;i<end;i++) {
+		if (text[i]=='\n') continue;
+		place_line_glyf( fs, text[i], tl.ppem, orient, x, y, advance, lg );
+		add_line_glyf( fs, lg, tl.ppem, orient, x, y, x0, x1, et, before, cut );
+	}
+	if (et.overflow) et.numedges = before;
+}
+
+// after a band n rows tall had numedges edges, how tall the next one can
+// be and still fit in the table, up to max
+int16_t next_size( int16_t n, uint16_t numedges, int16_t max ) {
+	int32_t next = numedges ? (int32_t)n*MAX_EDGES/numedges : max;
+	if (next>max) return max;
+	return next<1 ? 1 : next;
+}
+
+// draw line line_i of laid out text, turned by orient. x,y (subpixels) is
+// the top left corner of the display box the line lands in. every display
+// row the line covers, from the top of the font's ascent to the bottom of
+// its descent (or left to right for ORIENT_90), is sent to emit, top row
+// first. returns false if a single glyph crossed more than MAX_EDGES edges
+// in one row, then that row is drawn wrong.
+bool render_line( fontset &fs, uint32_t *text, uint16_t len, text_layout &tl, uint16_t line_i, uint8_t orient, int32_t x, int32_t y, row_fn emit ) {
+	fontinfo &fi = fs.fi[0];
+	int32_t ascent = scale_funits( fi, fi.hhea_table_ascent.int16, tl.ppem );
+	int32_t descent = scale_funits( fi, fi.hhea_table_descent.int16, tl.ppem );
+	turned_origin( orient, tl.line_width[line_i], ascent - descent, x, y );
+	int32_t bx = 0, by = ascent; // start of baseline
+	orient_offset( orient, bx, by );
+	bx += x;
+	by += y;
+	rect line_box;
+	oriented_box( orient, x, y, 0, 0, tl.line_width[line_i], ascent - descent, line_box );
+	int16_t top = line_box.y0, bottom = line_box.y1;
+	uint8_t row[ROW_BYTES];
+	edge_table et;
+	line_glyfs lgs;
+	place_line( fs, text, len, tl, line_i, orient, bx, by, lgs );
+	bool ok = true;
+	int16_t cut;
+	int16_t band_height = BAND_HEIGHT;
+	int16_t band = top;
+	while (band<bottom) {
+		int16_t band_end = band+band_height<bottom ? band+band_height : bottom;
+		et.band_y0 = band*SUBPIXELS;
+		et.band_y1 = band_end*SUBPIXELS;
+		et.numedges = 0;
+		et.overflow = false;
+		add_line_edges( fs, text, len, tl, line_i, orient, bx, by, lgs, 0, ROW_WIDTH, et, cut );
+		if (et.overflow && band_height>1) {
+			band_height /= 2; // too many edges, try again with fewer rows
+			continue;
+		}
+		if (!et.overflow) {
+			sort_edges( et );
+			scan_rows( et, band, band_end, 0, ROW_WIDTH, row, emit );
+			band = band_end;
+			band_height = next_size( band_height, et.numedges, BAND_HEIGHT );
+			continue;
+		}
+		// one row, still too many edges. do it in slices, the first one
+		// from what is already in the table.
+		for (int i=0;i<ROW_BYTES;i++) row[i] = 0;
+		int16_t slice = 0;
+		int16_t slice_width = ROW_WIDTH;
+		bool filled = true;
+		while (slice<ROW_WIDTH) {
+			int16_t slice_end = slice+slice_width<ROW_WIDTH ? slice+slice_width : ROW_WIDTH;
+			if (!filled) {
+				et.numedges = 0;
+				et.overflow = false;
+				add_line_edges( fs, text, len, tl, line_i, orient, bx, by, lgs, slice, slice_end, et, cut );
+			}
+			filled = false;
+			if (et.overflow && cut<=slice && slice_width>1) {
+				slice_width /= 2; // the first glyph alone doesn't fit
+				continue;
+			}
+			if (et.overflow && cut<=slice) ok = false;
+			else if (et.overflow) slice_end = cut;
+			sort_edges( et );
+			scan_rows( et, band, band_end, slice, slice_end, row, 0 );
+			slice = slice_end;
+			slice_width = ROW_WIDTH;
+		}
+		emit( band, row );
+		band = band_end;
+	}
+	return ok;
+}
+
+// Embedded bitmaps. Some fonts carry hand tuned bitmaps ('strikes') for
+// small sizes, in the EBLC (locations) and EBDT (data) tables. Color fonts
+// use CBLC and CBDT, which have the same layout. If a strike exists for the
+// pixel size we want, we copy its bits straight to the output and skip the
+// outline entirely.
+// https://developer.apple.com/fonts/TrueType-Reference-Manual/RM06/Chap6EBLC.html
+// https://www.microsoft.com/typography/otspec/eblc.htm
+//
+// Only monochrome strikes (bitDepth 1) are used. Index subtable formats
+// 1 2 and 3, image formats 1 2 5 6 and 7. Everything else (sparse index
+// formats 4 and 5, composite bitmaps, PNG data in CBDT) falls back to the
+// outline.
+
+// one glyph inside a strike: where its image is and how it is stored
+typedef struct bitmap_glyf_t {
+	union uint16 image_format;
+	uint32_t image_offset; // from beginning of file
+	uint8_t height;
+	uint8_t width;
+	int8_t bearingX;
+	int8_t bearingY; // from baseline up to top row
+	uint8_t advance;
+} bitmap_glyf;
+
+void read_small_metrics( bitmap_glyf &bg, FILE * f ) {
+	uint8_t tmp;
+	read_uint8( bg.height, f );
+	read_uint8( bg.width, f );
+	read_uint8( tmp, f ); bg.bearingX = tmp;
+	read_uint8( tmp, f ); bg.bearingY = tmp;
+	read_uint8( bg.advance, f );
+}
+
+void read_big_metrics( bitmap_glyf &bg, FILE * f ) {
+	read_small_metrics( bg, f ); // hori metrics have the same layout
+	fseek( f, 3, SEEK_CUR ); // vertBearingX, vertBearingY, vertAdvance
+}
+
+// find a strike with ppem pixels per em, then the glyph inside of it.
+// returns false if there is no strike or the glyph is not in it.
+bool lookup_bitmap_glyf( fontinfo &fi, union uint32 &glyf_index, uint8_t ppem, bitmap_glyf &bg, FILE * f ) {
+	if (fi.eblc_table_offset.uint32==0 || fi.ebdt_table_offset.uint32==0) return false;
+	union uint32 numSizes;
+	fseek( f, fi.eblc_table_offset.uint32 + 4, SEEK_SET ); // skip version
+	read_uint32( numSizes, f );
+	union uint32 indexSubTableArrayOffset, numberOfIndexSubTables;
+	union uint16 startGlyphIndex, endGlyphIndex;
+	uint8_t ppemX, ppemY, bitDepth;
+	for (uint32_t i=0;i<numSizes.uint32;i++) {
+		// bitmapSizeTable records are 48 bytes each
+		fseek( f, fi.eblc_table_offset.uint32 + 8 + 48*i, SEEK_SET );
+		read_uint32( indexSubTableArrayOffset, f );
+		fseek( f, 4, SEEK_CUR ); // indexTablesSize
+		read_uint32( numberOfIndexSubTables, f );
+		fseek( f, 4, SEEK_CUR ); // colorRef
+		fseek( f, 24, SEEK_CUR ); // hori and vert sbitLineMetrics
+		read_uint16( startGlyphIndex, f );
+		read_uint16( endGlyphIndex, f );
+		read_uint8( ppemX, f );
+		read_uint8( ppemY, f );
+		read_uint8( bitDepth, f );
+		if (ppemY!=ppem || bitDepth!=1) continue;
+		if (glyf_index.uint32<startGlyphIndex.uint16) continue;
+		if (glyf_index.uint32>endGlyphIndex.uint16) continue;
+
+		uint32_t array_i = fi.eblc_table_offset.uint32 + indexSubTableArrayOffset.uint32;
+		union uint16 firstGlyphIndex, lastGlyphIndex;
+		union uint32 additionalOffset;
+		for (uint32_t j=0;j<numberOfIndexSubTables.uint32;j++) {
+			fseek( f, array_i + 8*j, SEEK_SET );
+			read_uint16( firstGlyphIndex, f );
+			read_uint16( lastGlyphIndex, f );
+			read_uint32( additionalOffset, f );
+			if (glyf_index.uint32<firstGlyphIndex.uint16) continue;
+			if (glyf_index.uint32>lastGlyphIndex.uint16) continue;
+
+			union uint16 indexFormat;
+			union uint32 imageDataOffset;
+			fseek( f, array_i + additionalOffset.uint32, SEEK_SET );
+			read_uint16( indexFormat, f );
+			read_uint16( bg.image_format, f );
+			read_uint32( imageDataOffset, f );
+			// image format 5 has no metrics of its own, only index
+			// format 2 carries them
+			if (bg.image_format.uint16==5 && indexFormat.uint16!=2) return false;
+			uint32_t k = glyf_index.uint32 - firstGlyphIndex.uint16;
+			uint32_t data_i = fi.ebdt_table_offset.uint32 + imageDataOffset.uint32;
+			if (indexFormat.uint16==1) {
+				// uint32 offsets, one more than number of glyphs
+				union uint32 o0, o1;
+				fseek( f, 4*k, SEEK_CUR );
+				read_uint32( o0, f );
+				read_uint32( o1, f );
+				if (o0.uint32==o1.uint32) return false; // no bitmap
+				bg.image_offset = data_i + o0.uint32;
+			} else if (indexFormat.uint16==3) {
+				// same, with uint16 offsets
+				union uint16 o0, o1;
+				fseek( f, 2*k, SEEK_CUR );
+				read_uint16( o0, f );
+				read_uint16( o1, f );
+				if (o0.uint16==o1.uint16) return false;
+				bg.image_offset = data_i + o0.uint16;
+			} else if (indexFormat.uint16==2) {
+				// every glyph same size, metrics are here, not in EBDT
+				union uint32 imageSize;
+				read_uint32( imageSize, f );
+				read_big_metrics( bg, f );
+				bg.image_offset = data_i + k*imageSize.uint32;
+			} else {
+				return false;
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+// copy bits to the display, most significant bit first. byte aligned
+// formats pad each row to a whole byte, bit aligned formats do not.
+// each pixel is turned by orient around the origin x,y on its way out.
+void stream_bitmap( bitmap_glyf &bg, bool byte_aligned, uint8_t orient, int16_t x, int16_t y, rect &clip, plot_fn plot, FILE * f ) {
+	uint8_t byte = 0;
+	uint8_t bits_left = 0;
+	for (int r=0;r<bg.height;r++) {
+		if (byte_aligned) bits_left = 0;
+		for (int c=0;c<bg.width;c++) {
+			if (bits_left==0) {
+				read_uint8( byte, f );
+				bits_left = 8;
+			}
+			// turn the middle of the pixel, in half pixels
+			int32_t dx = 2*(bg.bearingX+c)+1, dy = 2*(r-bg.bearingY)+1;
+			orient_offset( orient, dx, dy );
+			int16_t px = x+(dx>>1), py = y+(dy>>1);
+			bool inside = px>=clip.x0 && px<clip.x1 && py>=clip.y0 && py<clip.y1;
+			if ((byte & 0x80) && inside) plot( px, py );
+			byte <<= 1;
+			bits_left--;
+		}
+	}
+}
+
+// draw a glyph from a bitmap strike, with its origin (on the baseline) at
+// x,y. returns false if there is no usable bitmap for this size.
+bool render_bitmap_glyf( fontinfo &fi, union uint32 &glyf_index, uint8_t ppem, uint8_t orient, int16_t x, int16_t y, rect &clip, plot_fn plot, FILE * f ) {
+	bitmap_glyf bg;
+	if (!lookup_bitmap_glyf( fi, glyf_index, ppem, bg, f )) return false;
+	fseek( f, bg.image_offset, SEEK_SET );
+	switch (bg.image_format.uint16) {
+	case 1: read_small_metrics( bg, f ); stream_bitmap( bg, true, orient, x, y, clip, plot, f ); break;
+	case 2: read_small_metrics( bg, f ); stream_bitmap( bg, false, orient, x, y, clip, plot, f ); break;
+	case 5: stream_bitmap( bg, false, orient, x, y, clip, plot, f ); break; // metrics from EBLC
+	case 6: read_big_metrics( bg, f ); stream_bitmap( bg, true, orient, x, y, clip, plot, f ); break;
+	case 7: read_big_metrics( bg, f ); stream_bitmap( bg, false, orient, x, y, clip, plot, f ); break;
+	default: return false;
+	}
+	return true;
+}
+
+// draw a glyph at ppem pixels per em, origin at x,y (subpixels), only
+// inside clip. bitmap strikes are used when the font has one for this
+// size, outlines are only the fallback. false if the outline overflowed
+// the edge table, as in render_outline_glyf.
+bool render_glyf( fontinfo &fi, union uint32 &glyf_index, uint8_t ppem, uint8_t orient, int32_t x, int32_t y, rect &clip, plot_fn plot, FILE * f ) {
+	int16_t px = x >> SUBPIXEL_SHIFT, py = y >> SUBPIXEL_SHIFT;
+	if (render_bitmap_glyf( fi, glyf_index, ppem, orient, px, py, clip, plot, f )) return true;
+	return render_outline_glyf( fi, glyf_index, ppem, orient, x, y, clip, plot, f );
+}
+
+// Text surface, for e-paper partial refresh.
+//
+// A partial refresh of an e-paper panel is slow, and a full refresh is
+// slower, so only the parts of the text that changed should be redrawn.
+// The surface remembers where every glyph went last time. On update the
+// new text is laid out and compared glyph by glyph against that list. A
+// glyph that is the same and at the same place is left alone. Old glyphs
+// that are gone, and new glyphs that weren't there, make the area under
+// their bounding boxes 'dirty'. Each dirty rectangle is then cleared, and
+// only glyphs touching it are drawn again, clipped to it. The rectangles
+// are kept in ts.dirty for the panel driver to refresh.
+//
+// To save memory, the new layout is not stored while comparing. It is
+// walked twice: once to compare, and once to save it for next time.
+// Glyphs past the first SURFACE_MAX_GLYFS can't be remembered one by one,
+// so they are kept as a single 'spill' box. That box is dirty on every
+// update, in the old frame and the new one, and those glyphs are drawn
+// again by walking the layout a third time.
+//
+// With an orient other than ORIENT_0, lines run along the turned axis and
+// wrap at the area's turned width. For example with ORIENT_90 the text
+// reads top to bottom, and lines stack from the right edge of the area.
+#ifndef SURFACE_MAX_GLYFS
+#define SURFACE_MAX_GLYFS 64 // 16 bytes each
+#endif
+#ifndef SURFACE_MAX_DIRTY
+#define SURFACE_MAX_DIRTY 8
+#endif
+
+// erase a rectangle of the display to background (white)
+typedef void (*clear_fn)( rect &r );
+
+typedef struct placed_glyf_t {
+	uint8_t font_i; // in the fontset
+	bool same; // found unchanged in the new frame
+	uint16_t glyf_index;
+	int16_t x, y; // origin, subpixels
+	rect box; // pixels
+} placed_glyf;
+
+typedef struct text_surface_t {
+	rect area; // where on the display the text goes
+	uint8_t ppem;
+	uint8_t orient;
+	int32_t width, height; // subpixels, of the area before turning
+	int32_t origin_x, origin_y; // subpixels, where the first line starts
+	int16_t line_height; // subpixels
+	int16_t ascent; // subpixels, top of line to baseline
+	uint16_t numglyfs;
+	placed_glyf g[SURFACE_MAX_GLYFS];
+	bool spilled; // some glyfs didn't fit in g
+	rect spill; // pixels, around all of them
+	uint8_t numdirty;
+	rect dirty[SURFACE_MAX_DIRTY];
+	text_layout tl;
+} text_surface;
+
+// walks the laid out text one inked glyph at a time
+typedef struct surface_cursor_t {
+	uint16_t i; // next code point in text
+	uint16_t line;
+	int32_t x; // subpixels along the line
+} surface_cursor;
+
+void init_surface( text_surface &ts, fontset &fs, rect &area, uint8_t ppem, uint8_t orient ) {
+	fontinfo &fi = fs.fi[0];
+	ts.area = area;
+	ts.ppem = ppem;
+	ts.orient = orient;
+	ts.width = (area.x1-area.x0)*SUBPIXELS;
+	ts.height = (area.y1-area.y0)*SUBPIXELS;
+	if (orient & 1) {
+		int32_t tmp = ts.width;
+		ts.width = ts.height;
+		ts.height = tmp;
+	}
+	ts.origin_x = area.x0*SUBPIXELS;
+	ts.origin_y = area.y0*SUBPIXELS;
+	turned_origin( orient, ts.width, ts.height, ts.origin_x, ts.origin_y );
+	ts.ascent = scale_funits( fi, fi.hhea_table_ascent.int16, ppem );
+	ts.line_height = ts.ascent - scale_funits( fi, fi.hhea_table_descent.int16, ppem )
+	 + scale_funits( fi, fi.hhea_table_lineGap.int16, ppem );
+	ts.numglyfs = 0;
+	ts.spilled = false;
+	ts.numdirty = 0;
+}
+
+// place the next glyph that has ink. spaces and newlines only move the
+// cursor. returns false at the end of the text or the bottom of the area.
+bool next_placed_glyf( text_surface &ts, fontset &fs, uint32_t *text, uint16_t len, surface_cursor &sc, placed_glyf &pg ) {
+	while (sc.i<len) {
+		while (sc.line+1<ts.tl.numlines && sc.i>=ts.tl.line_start[sc.line+1]) {
+			sc.line++;
+			sc.x = 0;
+		}
+		int32_t y = ts.ascent + sc.line*ts.line_height;
+		if (y - ts.ascent + ts.line_height > ts.height) return false;
+		uint32_t c = text[sc.i++];
+		if (c=='\n') continue;
+		union uint32 glyf_index;
+		glyf_metrics gm;
+		lookup_fontset_glyf( fs, c, pg.font_i, glyf_index );
+		fontinfo &fi = fs.fi[pg.font_i];
+		measure_glyf( fi, glyf_index, gm, true, fs.file[pg.font_i] );
+		int32_t x = sc.x;
+		orient_offset( ts.orient, x, y );
+		pg.glyf_index = glyf_index.uint32;
+		pg.x = ts.origin_x + x;
+		pg.y = ts.origin_y + y;
+		pg.same = false;
+		sc.x += scale_funits( fi, gm.advanceWidth.uint16, ts.ppem );
+		if (gm.gd.numberOfContours.int16==0) continue;
+		glyf_pixel_box( fi, gm.gd, ts.ppem, ts.orient, pg.x, pg.y, pg.box );
+		return true;
+	}
+	return false;
+}
+
+int32_t area_of( rect &r ) {
+	return (int32_t)(r.x1-r.x0) * (r.y1-r.y0);
+}
+
+void unite( rect &a, rect &b ) {
+	if (b.x0<a.x0) a.x0 = b.x0;
+	if (b.y0<a.y0) a.y0 = b.y0;
+	if (b.x1>a.x1) a.x1 = b.x1;
+	if (b.y1>a.y1) a.y1 = b.y1;
+}
+
+// add to the dirty list, merging rectangles that overlap or touch. when
+// the list is full, merge with whichever rectangle grows the least.
+void add_dirty( text_surface &ts, rect &r ) {
+	rect d;
+	if (!intersect( r, ts.area, d )) return;
+	uint8_t i = 0;
+	while (i<ts.numdirty) {
+		rect &o = ts.dirty[i];
+		if (d.x0>o.x1 || d.x1<o.x0 || d.y0>o.y1 || d.y1<o.y0) {
+			i++;
+			continue;
+		}
+		unite( d, o );
+		ts.dirty[i] = ts.dirty[--ts.numdirty];
+		i = 0; // grown, so it may touch ones already passed
+	}
+	if (ts.numdirty<SURFACE_MAX_DIRTY) {
+		ts.dirty[ts.numdirty++] = d;
+		return;
+	}
+	uint8_t best = 0;
+	int32_t best_growth = 0;
+	for (i=0;i<ts.numdirty;i++) {
+		rect u = ts.dirty[i];
+		unite( u, d );
+		int32_t growth = area_of( u ) - area_of( ts.dirty[i] );
+		if (i==0 || growth<best_growth) {
+			best = i;
+			best_growth = growth;
+		}
+	}
+	unite( d, ts.dirty[best] );
+	ts.dirty[best] = ts.dirty[--ts.numdirty];
+	add_dirty( ts, d ); // may now touch others
+}
+
+bool draw_placed_glyf( text_surface &ts, fontset &fs, placed_glyf &g, rect &clip, plot_fn plot ) {
+	union uint32 glyf_index;
+	glyf_index.uint32 = g.glyf_index;
+	return render_glyf( fs.fi[g.font_i], glyf_index, ts.ppem, ts.orient, g.x, g.y, clip, plot, fs.file[g.font_i] );
+}
+
+// lay out new text, redraw only what changed. afterwards ts.dirty holds
+// the rectangles the panel needs to refresh. false if some glyph was drawn
+// wrong, see render_outline_glyf.
+bool update_surface( text_surface &ts, fontset &fs, uint32_t *text, uint16_t len, clear_fn clear, plot_fn plot ) {
+	layout_text( fs, text, len, ts.ppem, ts.width, ts.tl );
+	ts.numdirty = 0;
+	for (uint16_t j=0;j<ts.numglyfs;j++) ts.g[j].same = false;
+
+	// pass one: compare against the last frame
+	surface_cursor sc = { 0, 0, 0 };
+	placed_glyf pg;
+	uint16_t n = 0;
+	while (n<SURFACE_MAX_GLYFS && next_placed_glyf( ts, fs, text, len, sc, pg )) {
+		n++;
+		bool found = false;
+		for (uint16_t j=0;j<ts.numglyfs && !found;j++) {
+			placed_glyf &old = ts.g[j];
+			if (old.same || old.glyf_index!=pg.glyf_index || old.font_i!=pg.font_i) continue;
+			if (old.x!=pg.x || old.y!=pg.y) continue;
+			old.same = found = true;
+		}
+		if (!found) add_dirty( ts, pg.box );
+	}
+	for (uint16_t j=0;j<ts.numglyfs;j++) {
+		if (!ts.g[j].same) add_dirty( ts, ts.g[j].box );
+	}
+	if (ts.spilled) add_dirty( ts, ts.spill );
+
+	// pass two: remember the new frame
+	sc.i = 0; sc.line = 0; sc.x = 0;
+	ts.numglyfs = 0;
+	ts.spilled = false;
+	while (next_placed_glyf( ts, fs, text, len, sc, pg )) {
+		if (ts.numglyfs<SURFACE_MAX_GLYFS) {
+			ts.g[ts.numglyfs++] = pg;
+		} else if (ts.spilled) {
+			unite( ts.spill, pg.box );
+		} else {
+			ts.spill = pg.box;
+			ts.spilled = true;
+		}
+	}
+	if (ts.spilled) add_dirty( ts, ts.spill );
+
+	// redraw the dirty rectangles. they don't overlap, so all can be
+	// cleared first. render_glyf also skips reading any outline whose
+	// bounding box misses the rectangle.
+	rect clip;
+	bool ok = true;
+	for (uint8_t i=0;i<ts.numdirty;i++) clear( ts.dirty[i] );
+	for (uint8_t i=0;i<ts.numdirty;i++) {
+		for (uint16_t j=0;j<ts.numglyfs;j++) {
+			if (!intersect( ts.g[j].box, ts.dirty[i], clip )) continue;
+			if (!draw_placed_glyf( ts, fs, ts.g[j], clip, plot )) ok = false;
+		}
+	}
+	if (!ts.spilled) return ok;
+
+	// pass three: the glyfs that didn't fit
+	sc.i = 0; sc.line = 0; sc.x = 0;
+	n = 0;
+	while (next_placed_glyf( ts, fs, text, len, sc, pg )) {
+		if (n<SURFACE_MAX_GLYFS) {
+			n++;
+			continue;
+		}
+		for (uint8_t i=0;i<ts.numdirty;i++) {
+			if (!intersect( pg.box, ts.dirty[i], clip )) continue;
+			if (!draw_placed_glyf( ts, fs, pg, clip, plot )) ok = false;
+		}
+	}
+	return ok;
+}
+
 #ifdef DEBUG
 void printglyfflag( uint8_t &f ){
 	printf("GF_ON_CURVE   %i\n", f & GF_ON_CURVE );
@@ -737,7 +2300,15 @@ void printinfo( fontinfo &f ){
 	printf("glyf table offset hex %08x\n",f.glyf_table_offset.uint32);
 	printf("loca table offset hex %08x\n",f.loca_table_offset.uint32);
 	printf("head table offset hex %08x\n",f.head_table_offset.uint32);
+	printf("eblc table offset hex %08x\n",f.eblc_table_offset.uint32);
+	printf("ebdt table offset hex %08x\n",f.ebdt_table_offset.uint32);
 	printf("head table indexToLocFormat %i\n",f.head_table_indexToLocFormat.int16);
+	printf("head table unitsPerEm %u\n",f.head_table_unitsPerEm.uint16);
+	printf("hhea table offset hex %08x\n",f.hhea_table_offset.uint32);
+	printf("hhea table ascent %i descent %i lineGap %i\n",f.hhea_table_ascent.int16,f.hhea_table_descent.int16,f.hhea_table_lineGap.int16);
+	printf("hhea table numberOfHMetrics %u\n",f.hhea_table_numberOfHMetrics.uint16);
+	printf("hmtx table offset hex %08x\n",f.hmtx_table_offset.uint32);
+	printf("maxp table offset hex %08x numGlyphs %u\n",f.maxp_table_offset.uint32,f.maxp_table_numGlyphs.uint16);
 	if (f.head_table_indexToLocFormat.int16==0)
 		printf("  locformat: short (offsets=number of 16-bit words)\n");
 	else if (f.head_table_indexToLocFormat.int16==1)
@@ -753,7 +2324,7 @@ void printglyfdescr( glyf_description &gd ){
 	printf("yMin %i\n",gd.yMin.int16);
 	printf("yMax %i\n",gd.yMax.int16);
 }
-#endif // DEBUG
+#endif
 
 FILE *openfile( const char *filename ) {
 	FILE * f = fopen(filename,"rb");
@@ -761,24 +2332,331 @@ FILE *openfile( const char *filename ) {
 	if (!f) {
 		printf("can't open file %s\n",filename);
 	}
-#endif // DEBUG
+#endif
 	return f;
 }
 
+#ifdef MEASURE
+// RAM measurement, see the ramcheck script. Every stage of the pipeline is
+// run over the whole font, one noinline function per stage so that its
+// frame (and everything it calls) is below main(). Before each stage the
+// stack below main() is painted with a known byte, afterwards the lowest
+// byte that changed is the high water mark. The few bytes of the painting
+// function's own frame are counted too, which is the same for every build.
+// Link with -z now, or the dynamic linker's lazy binding is counted too.
+// Results go to stderr as 'name value' lines, trace output to stdout.
+#ifndef STACK_PAINT
+#define STACK_PAINT 32768 // bytes below main() to paint
+#endif
+#define STACK_PATTERN 0xA5
+#define MEASURE_PPEM 32
+#define CHUNK_LEN 128 // code points laid out and drawn at once
+
+uintptr_t stack_low; // lowest painted byte
+uintptr_t stack_top; // just above the painted bytes
+
+__attribute__((noinline)) void paint_stack() {
+	volatile uint8_t paint[STACK_PAINT];
+	for (int i=0;i<STACK_PAINT;i++) paint[i] = STACK_PATTERN;
+	stack_low = (uintptr_t)paint;
+	stack_top = stack_low + STACK_PAINT;
+}
+
+uint32_t stack_used() {
+	uintptr_t p = stack_low;
+	while (p<stack_top && *(volatile uint8_t *)p==STACK_PATTERN) p++;
+	return stack_top - p; // STACK_PAINT means it ran off the end
+}
+
+void report( const char *name, uint32_t value ) {
+	fprintf( stderr, "%s %u\n", name, value );
+}
+
+uint32_t pixels;
+void count_pixel( int16_t x, int16_t y ) { pixels++; }
+void count_row( int16_t y, uint8_t *row ) {
+	for (int i=0;i<ROW_BYTES;i++) for (uint8_t b=row[i];b;b&=b-1) pixels++;
+}
+
+// the surface stage draws into panel, and checks it against every glyf
+// of the text drawn again from scratch into fresh
+#define PANEL_HEIGHT 300
+uint8_t panel[PANEL_HEIGHT][ROW_BYTES];
+uint8_t fresh[PANEL_HEIGHT][ROW_BYTES];
+void panel_clear( rect &r ) {
+	for (int16_t y=r.y0;y<r.y1;y++) {
+		for (int16_t x=r.x0;x<r.x1;x++) panel[y][x>>3] &= ~(0x80>>(x&7));
+	}
+}
+void panel_plot( int16_t x, int16_t y ) {
+	pixels++;
+	panel[y][x>>3] |= 0x80>>(x&7);
+}
+void fresh_plot( int16_t x, int16_t y ) {
+	fresh[y][x>>3] |= 0x80>>(x&7);
+}
+
+__attribute__((noinline)) void stage_load( fontset &fs, FILE * f ) {
+	init_fontset( fs );
+	add_font( fs, f );
+}
+
+__attribute__((noinline)) uint32_t stage_lookup( fontset &fs ) {
+	uint32_t found = 0;
+	uint8_t font_i;
+	union uint32 glyf_index;
+	for (uint32_t u=0;u<0x10000;u++) {
+		lookup_fontset_glyf( fs, u, font_i, glyf_index );
+		if (glyf_index.uint32!=0) found++;
+	}
+	return found;
+}
+
+__attribute__((noinline)) uint32_t stage_measure( fontinfo &fi, FILE * f ) {
+	uint32_t advance = 0;
+	glyf_metrics gm;
+	union uint32 glyf_index;
+	for (glyf_index.uint32=0;glyf_index.uint32<fi.maxp_table_numGlyphs.uint16;glyf_index.uint32++) {
+		measure_glyf( fi, glyf_index, gm, true, f );
+		advance += gm.advanceWidth.uint16;
+	}
+	return advance;
+}
+
+uint32_t overflows; // glyfs or lines drawn wrong for lack of edges
+
+// read every outline into the edge table, in bands the way
+// render_outline_glyf does, without scanning them. returns the edges of
+// all bands.
+__attribute__((noinline)) uint32_t stage_decode( fontinfo &fi, FILE * f ) {
+	overflows = 0;
+	uint32_t edges = 0;
+	glyf_description gd;
+	uint32_t glyfdataoffset;
+	rect box;
+	edge_table et;
+	outline_pen pen;
+	int32_t x = 64*SUBPIXELS, y = 64*SUBPIXELS;
+	union uint32 glyf_index;
+	for (glyf_index.uint32=0;glyf_index.uint32<fi.maxp_table_numGlyphs.uint16;glyf_index.uint32++) {
+		if (!read_glyf_header( fi, glyf_index, gd, glyfdataoffset, f )) continue;
+		glyf_pixel_box( fi, gd, MEASURE_PPEM, ORIENT_0, x, y, box );
+		int16_t band_height = BAND_HEIGHT;
+		int16_t band = box.y0;
+		while (band<box.y1) {
+			int16_t band_end = band+band_height<box.y1 ? band+band_height : box.y1;
+			et.band_y0 = band*SUBPIXELS;
+			et.band_y1 = band_end*SUBPIXELS;
+			et.numedges = 0;
+			et.overflow = false;
+			init_pen( pen, fi, MEASURE_PPEM, ORIENT_0, x, y );
+			do_glyf_data( gd, f, glyfdataoffset, pen, et );
+			if (et.overflow && band_height>1) {
+				band_height /= 2;
+				continue;
+			}
+			if (et.overflow) overflows++;
+			edges += et.numedges;
+			band = band_end;
+		}
+	}
+	return edges;
+}
+
+__attribute__((noinline)) uint32_t stage_raster( fontinfo &fi, FILE * f ) {
+	pixels = 0;
+	overflows = 0;
+	rect clip = { 0, 0, 4*MEASURE_PPEM, 4*MEASURE_PPEM };
+	union uint32 glyf_index;
+	for (glyf_index.uint32=0;glyf_index.uint32<fi.maxp_table_numGlyphs.uint16;glyf_index.uint32++) {
+		if (!render_glyf( fi, glyf_index, MEASURE_PPEM, ORIENT_0, MEASURE_PPEM*2*SUBPIXELS, MEASURE_PPEM*2*SUBPIXELS, clip, count_pixel, f )) overflows++;
+	}
+	return pixels;
+}
+
+// the next CHUNK_LEN covered code points after u, with a space after every
+// eighth so that lines can break
+uint16_t next_chunk( fontset &fs, uint32_t &u, uint32_t *text ) {
+	uint16_t len = 0;
+	uint8_t font_i;
+	union uint32 glyf_index;
+	for (;u<0x10000 && len<CHUNK_LEN;u++) {
+		if (u==' ' || u=='\n') continue;
+		lookup_fontset_glyf( fs, u, font_i, glyf_index );
+		if (glyf_index.uint32==0) continue;
+		text[len++] = u;
+		if (len%9==8) text[len++] = ' ';
+	}
+	return len;
+}
+
+__attribute__((noinline)) uint32_t stage_line( fontset &fs, uint32_t *text, text_layout &tl ) {
+	pixels = 0;
+	overflows = 0;
+	outline_reads = 0;
+	uint32_t u = 0;
+	uint16_t len;
+	while ((len = next_chunk( fs, u, text ))) {
+		layout_text( fs, text, len, 16, ROW_WIDTH*SUBPIXELS, tl );
+		for (uint16_t i=0;i<tl.numlines;i++) {
+			if (!render_line( fs, text, len, tl, i, ORIENT_0, 0, 0, count_row )) overflows++;
+		}
+	}
+	return pixels;
+}
+
+uint32_t wrong_frames; // where the panel and a full redraw differ
+
+__attribute__((noinline)) uint32_t stage_surface( fontset &fs, uint32_t *text, text_surface &ts ) {
+	pixels = 0;
+	overflows = 0;
+	wrong_frames = 0;
+	rect area = { 0, 0, ROW_WIDTH, PANEL_HEIGHT };
+	init_surface( ts, fs, area, 16, ORIENT_0 );
+	uint32_t u = 0;
+	uint16_t len;
+	while ((len = next_chunk( fs, u, text ))) {
+		if (!update_surface( ts, fs, text, len, panel_clear, panel_plot )) overflows++;
+		for (int y=0;y<PANEL_HEIGHT;y++) for (int i=0;i<ROW_BYTES;i++) fresh[y][i] = 0;
+		surface_cursor sc = { 0, 0, 0 };
+		placed_glyf pg;
+		while (next_placed_glyf( ts, fs, text, len, sc, pg )) {
+			draw_placed_glyf( ts, fs, pg, area, fresh_plot );
+		}
+		bool same = true;
+		for (int y=0;y<PANEL_HEIGHT;y++) for (int i=0;i<ROW_BYTES;i++) same = same && panel[y][i]==fresh[y][i];
+		if (!same) wrong_frames++;
+	}
+	return pixels;
+}
+
+// strikes.ttf, made by mkstrikes.py, has a 12 ppem strike where glyf
+// 1+5*i+j uses index format 1 2 3 [i] and image format 1 2 5 6 7 [j], all
+// the same 5x7 X. index format 1 or 3 with image format 5 must be refused,
+// and glyf 16 is listed with no image. returns the glyfs not as expected.
+uint8_t strike_grid[8]; // bit 7 is x=0
+void strike_pixel( int16_t x, int16_t y ) {
+	if (x>=0 && x<8 && y>=0 && y<8) strike_grid[y] |= 0x80>>x;
+	else strike_grid[0] = 0xFF; // off the grid is always wrong
+}
+
+__attribute__((noinline)) uint32_t stage_strikes( FILE * f ) {
+	const uint8_t x_rows[8] = { 0x88, 0x50, 0x20, 0x20, 0x20, 0x50, 0x88, 0 };
+	const uint8_t image_formats[5] = { 1, 2, 5, 6, 7 };
+	uint32_t wrong = 0;
+	fontinfo fi;
+	read_fontinfo( fi, f );
+	rect clip = { -8, -8, 16, 16 };
+	union uint32 glyf_index;
+	for (glyf_index.uint32=1;glyf_index.uint32<=16;glyf_index.uint32++) {
+		uint8_t index_format = 1 + (glyf_index.uint32-1)/5;
+		uint8_t image_format = image_formats[(glyf_index.uint32-1)%5];
+		bool expect = glyf_index.uint32<16 && (index_format==2 || image_format!=5);
+		for (int i=0;i<8;i++) strike_grid[i] = 0;
+		// bearingY is 7, so the top row lands on y=0
+		bool drawn = render_bitmap_glyf( fi, glyf_index, 12, ORIENT_0, 0, 7, clip, strike_pixel, f );
+		bool same = true;
+		for (int i=0;i<8;i++) same = same && strike_grid[i]==(expect ? x_rows[i] : 0);
+		if (drawn!=expect || !same) wrong++;
+	}
+	return wrong;
+}
+
 int main(int argc, char * argv[]) {
-	const char * filename = "FreeSerif.ttf";
+	const char * filename = argc>1 ? argv[1] : "FreeSerif.ttf";
 	FILE *file = openfile( filename );
 	if (!file) return 1;
 
-	fontinfo fi;
-	read_uint32(fi.ofascaler,file);
-	read_uint16(fi.numtables,file);
-	fseek(file,12,SEEK_SET); // skip Offset Subtable
+	static fontset fs;
+	static text_layout tl;
+	static text_surface ts;
+	static uint32_t text[CHUNK_LEN+CHUNK_LEN/8];
+	report( "ram_fontset", sizeof(fs) );
+	report( "ram_coverage", sizeof(font_coverage) );
+	report( "ram_layout", sizeof(tl) );
+	report( "ram_surface", sizeof(ts) );
+	report( "ram_text", sizeof(text) );
+	report( "size_edge_table", sizeof(edge_table) );
+	report( "size_outline_pen", sizeof(outline_pen) );
+	report( "size_cmap_subtable_format4", sizeof(cmap_subtable_format4) );
+	report( "size_glyf_point", sizeof(glyf_point) );
+
+	paint_stack();
+	stage_load( fs, file );
+	report( "stack_load", stack_used() );
+	fontinfo &fi = fs.fi[0];
+	report( "glyfs", fi.maxp_table_numGlyphs.uint16 );
+
+	paint_stack();
+	uint32_t found = stage_lookup( fs );
+	report( "stack_lookup", stack_used() );
+	report( "codepoints", found );
+
+	paint_stack();
+	uint32_t advance = stage_measure( fi, file );
+	report( "stack_measure", stack_used() );
+	report( "advance_total", advance );
+
+	paint_stack();
+	uint32_t edges = stage_decode( fi, file );
+	report( "stack_decode", stack_used() );
+	report( "edges", edges );
+	report( "overflow_decode", overflows );
+
+	paint_stack();
+	uint32_t raster_pixels = stage_raster( fi, file );
+	report( "stack_raster", stack_used() );
+	report( "pixels_raster", raster_pixels );
+	report( "overflow_raster", overflows );
+
+	paint_stack();
+	uint32_t line_pixels = stage_line( fs, text, tl );
+	report( "stack_line", stack_used() );
+	report( "pixels_line", line_pixels );
+	report( "reads_line", outline_reads );
+	report( "overflow_line", overflows );
+
+	paint_stack();
+	uint32_t surface_pixels = stage_surface( fs, text, ts );
+	report( "stack_surface", stack_used() );
+	report( "pixels_surface", surface_pixels );
+	report( "overflow_surface", overflows );
+	report( "fail_surface", wrong_frames );
+
+	FILE *strikes = openfile( "strikes.ttf" );
+	if (!strikes) return 1;
+	paint_stack();
+	uint32_t wrong = stage_strikes( strikes );
+	report( "stack_strikes", stack_used() );
+	report( "fail_strikes", wrong );
 
-	read_table_directories( fi, file );
+	return 0;
+}
+#else
+void plotpixel( int16_t x, int16_t y ) {
+	printf("pixel %i %i\n", x, y );
+}
+
+void clearrect( rect &r ) {
+	printf("clear %i %i %i %i\n", r.x0, r.y0, r.x1, r.y1 );
+}
+
+void printrow( int16_t y, uint8_t *row ) {
+	printf("row %3i ", y );
+	for (int x=0;x<ROW_WIDTH;x++) printf( "%c", row[x>>3] & (0x80>>(x&7)) ? '#' : '.' );
+	printf("\n");
+}
+
+int main(int argc, char * argv[]) {
+	const char * filename = "FreeSerif.ttf";
+	FILE *file = openfile( filename );
+	if (!file) return 1;
 
-	read_head_table( fi, file );
+	fontinfo fi;
+	read_fontinfo( fi, file );
+#ifdef DEBUG
 	printinfo( fi );
+#endif
 
 	uint32_t unicode = 65;
 	//uint32_t unicode = 0x20d5;
@@ -793,8 +2671,74 @@ int main(int argc, char * argv[]) {
 	fseek( file, glyf_offset.uint32, SEEK_CUR);
 	glyf_description gd;
 	read_glyf_description( gd, file );
+#ifdef DEBUG
 	printglyfdescr( gd );
-	do_glyf_data( gd, file, ftell(file) );
+#endif
+	rect screen = { 0, 0, 80, 40 };
+	render_glyf( fi, glyf_index, 32, ORIENT_0, 4*SUBPIXELS, 32*SUBPIXELS, screen, plotpixel, file );
+
+	static fontset fs; // coverage bitsets are too big for the stack
+	init_fontset( fs );
+	add_font( fs, file );
+	uint8_t font_i;
+	lookup_fontset_glyf( fs, unicode, font_i, glyf_index );
+	printf("fontset: font %u, glyf index %u\n", font_i, glyf_index.uint32 );
+
+	const char * sample = "The quick brown fox jumps over the lazy dog.";
+	uint32_t text[64];
+	uint16_t len = 0;
+	while (sample[len]) { text[len] = sample[len]; len++; }
+	static text_layout tl;
+	layout_text( fs, text, len, 16, 120*SUBPIXELS, tl );
+	for (int i=0;i<tl.numlines;i++) {
+		printf("line %i start %u width %i px\n", i, tl.line_start[i], tl.line_width[i]>>SUBPIXEL_SHIFT );
+	}
+
+	// cut the end off a word that is broken over several lines, and check
+	// the reflow against laying out the whole text again
+	static uint32_t word[64];
+	static text_layout wl, check;
+	// the first line is a lone space, so the shortened word fits on it
+	uint16_t word_len = 0;
+	word[word_len++] = ' ';
+	while (word_len<41) word[word_len++] = 'm';
+	word[word_len++] = ' ';
+	word[word_len++] = 'b';
+	layout_text( fs, word, word_len, 16, 42*SUBPIXELS, wl );
+	uint16_t cut = wl.line_start[2];
+	uint16_t cut_n = 41 - cut;
+	for (uint16_t i=cut;i+cut_n<word_len;i++) word[i] = word[i+cut_n];
+	word_len -= cut_n;
+	reflow_text( fs, word, word_len, cut, cut_n, 0, wl );
+	layout_text( fs, word, word_len, 16, 42*SUBPIXELS, check );
+	bool same = wl.numlines==check.numlines;
+	for (int i=0;same && i<wl.numlines;i++) same = wl.line_start[i]==check.line_start[i] && wl.line_width[i]==check.line_width[i];
+	printf("reflow after edit: %u lines, %s\n", wl.numlines, same ? "same as layout" : "DIFFERENT from layout" );
+
+	render_line( fs, text, len, tl, 0, ORIENT_0, 0, 0, printrow );
+	render_line( fs, text, len, tl, 0, ORIENT_90, 0, 0, printrow );
+
+	static text_surface ts;
+	rect panel = { 0, 0, 200, 100 };
+	init_surface( ts, fs, panel, 16, ORIENT_0 );
+	update_surface( ts, fs, text, len, clearrect, plotpixel );
+	text[4] = 'k'; // quick -> kuick
+	update_surface( ts, fs, text, len, clearrect, plotpixel );
+	for (int i=0;i<ts.numdirty;i++) {
+		printf("dirty %i %i %i %i\n", ts.dirty[i].x0, ts.dirty[i].y0, ts.dirty[i].x1, ts.dirty[i].y1 );
+	}
+
+	bool bitmap = render_bitmap_glyf( fi, glyf_index, 12, ORIENT_0, 0, 12, screen, plotpixel, file );
+	printf("bitmap strike at 12 ppem: %s\n", bitmap ? "yes" : "no" );
+	FILE *strikes = openfile( "strikes.ttf" ); // see mkstrikes.py
+	if (strikes) {
+		fontinfo si;
+		read_fontinfo( si, strikes );
+		glyf_index.uint32 = 1;
+		bitmap = render_bitmap_glyf( si, glyf_index, 12, ORIENT_0, 0, 7, screen, plotpixel, strikes );
+		printf("strikes.ttf glyf 1 at 12 ppem: %s\n", bitmap ? "yes" : "no" );
+	}
 
 	return 0;
 }
+#endif